@@ -3,10 +3,14 @@
 #include <stdio.h>
 #include <string.h>
 #include "mkem.h"
+#include "mkem_session.h"
+#include "poly.h"
 #include "randombytes.h"
 
 #define NRUNS 1000
 #define MAXUSERS 1000
+#define MAXBATCH 64
+#define NTTBATCH 16
  
 static inline uint64_t cpucycles(void) {
   uint64_t result;
@@ -46,7 +50,9 @@ static uint64_t median(uint64_t *l, size_t llen) {
 }
 
 
-static void print_bench(char *s, int n, int k, uint64_t *t,size_t tlen)
+/* Prints the median of the cycle counts divided by div,
+ * e.g., the number of messages processed per run */
+static void print_bench_div(char *s, int n, int k, uint64_t *t,size_t tlen, size_t div)
 {
   static uint64_t overhead = -1;
   size_t i;
@@ -74,6 +80,15 @@ static void print_bench(char *s, int n, int k, uint64_t *t,size_t tlen)
     case 2:
       printf("two");
       break;
+    case 4:
+      printf("four");
+      break;
+    case 16:
+      printf("sixteen");
+      break;
+    case 64:
+      printf("sixtyfour");
+      break;
     case 10:
       printf("X");
       break;
@@ -84,7 +99,12 @@ static void print_bench(char *s, int n, int k, uint64_t *t,size_t tlen)
       printf("M");
       break;
   }
-  printf("avx}{$%lu$}\n",median(t, tlen));
+  printf("avx}{$%lu$}\n",median(t, tlen)/div);
+}
+
+static void print_bench(char *s, int n, int k, uint64_t *t,size_t tlen)
+{
+  print_bench_div(s, n, k, t, tlen, 1);
 }
 
 static void run_bench(void)
@@ -96,13 +116,22 @@ static void run_bench(void)
 
   uint8_t c1[MKYBER_C1BYTES];
   uint8_t *c2s[MAXUSERS];
+  uint8_t *flatpks, *flatc2s;
+  mkem_session *session;
 
   uint8_t key_a[KYBER_SSBYTES];
   uint8_t key_b[KYBER_SSBYTES];
 
+  uint8_t *c1s[MAXBATCH];
+  uint8_t *sss[MAXBATCH];
+  uint8_t *c2p[1];
+  const size_t batches[3] = {4, 16, 64};
+
+  static poly polys[NTTBATCH];
+
   uint64_t t[NRUNS];
 
-  size_t i;
+  size_t i, j;
 
   for(i=0;i<MAXUSERS;i++)
   {
@@ -152,6 +181,32 @@ static void run_bench(void)
   }
   print_bench("\\menccyc",1000,KYBER_K,t,NRUNS);
 
+  /* Same with all keys and ciphertexts in two flat buffers */
+  flatpks = malloc(MAXUSERS*MKYBER_PUBLICKEYBYTES);
+  flatc2s = malloc(MAXUSERS*MKYBER_C2BYTES);
+  for(i=0;i<MAXUSERS;i++)
+    memcpy(flatpks+i*MKYBER_PUBLICKEYBYTES, pks[i], MKYBER_PUBLICKEYBYTES);
+
+  for(i=0;i<NRUNS;i++) {
+    t[i] = cpucycles();
+    crypto_mkem_enc_strided(c1, flatc2s, MKYBER_C2BYTES, key_a, seed, 1000, flatpks, MKYBER_PUBLICKEYBYTES);
+  }
+  print_bench("\\mencstridedcyc",1000,KYBER_K,t,NRUNS);
+
+  free(flatpks);
+  free(flatc2s);
+
+  /* Adding one recipient to an existing group session */
+  session = crypto_mkem_session_new(c1, key_a, seed);
+  if(session != NULL) {
+    for(i=0;i<NRUNS;i++) {
+      t[i] = cpucycles();
+      crypto_mkem_session_add(session, c2s[i%MAXUSERS], pks[i%MAXUSERS]);
+    }
+    print_bench("\\msessionaddcyc",0,KYBER_K,t,NRUNS);
+    crypto_mkem_session_free(session);
+  }
+
   for(i=0;i<NRUNS;i++)
   {
     t[i] = cpucycles();
@@ -159,6 +214,77 @@ static void run_bench(void)
   }
   print_bench("\\mdeccyc",0,KYBER_K,t,NRUNS);
 
+  /* Batch decapsulation, cycles per message */
+  for(i=0;i<MAXBATCH;i++)
+  {
+    c1s[i] = malloc(MKYBER_C1BYTES);
+    sss[i] = malloc(KYBER_SSBYTES);
+    c2p[0] = c2s[i];
+    crypto_mkem_enc(c1s[i], c2p, key_a, seed, 1, pks);
+  }
+
+  for(j=0;j<3;j++)
+  {
+    for(i=0;i<NRUNS;i++)
+    {
+      t[i] = cpucycles();
+      crypto_mkem_dec_batch(sss, (const uint8_t *const *)c1s, (const uint8_t *const *)c2s, batches[j], sks[0]);
+    }
+    print_bench_div("\\mdecbatchcyc",batches[j],KYBER_K,t,NRUNS,batches[j]);
+  }
+
+  /* (Inverse) NTT throughput, cycles per polynomial */
+  for(i=0;i<NRUNS;i++)
+  {
+    t[i] = cpucycles();
+    for(j=0;j<NTTBATCH;j++)
+      poly_ntt(&polys[j]);
+  }
+  print_bench_div("\\nttcyc",0,KYBER_K,t,NRUNS,NTTBATCH);
+
+  for(i=0;i<NRUNS;i++)
+  {
+    t[i] = cpucycles();
+    poly_ntt_batch(polys, NTTBATCH);
+  }
+  print_bench_div("\\nttbatchcyc",NTTBATCH,KYBER_K,t,NRUNS,NTTBATCH);
+
+  for(i=0;i<NRUNS;i++)
+  {
+    t[i] = cpucycles();
+    for(j=0;j<NTTBATCH;j++)
+      poly_invntt_tomont(&polys[j]);
+  }
+  print_bench_div("\\invnttcyc",0,KYBER_K,t,NRUNS,NTTBATCH);
+
+  for(i=0;i<NRUNS;i++)
+  {
+    t[i] = cpucycles();
+    poly_invntt_tomont_batch(polys, NTTBATCH);
+  }
+  print_bench_div("\\invnttbatchcyc",NTTBATCH,KYBER_K,t,NRUNS,NTTBATCH);
+
+  /* Key generation and encapsulation with the buffered DRBG */
+  randombytes_select(RANDOMBYTES_DRBG);
+  for(i=0;i<NRUNS;i++) {
+    t[i] = cpucycles();
+    crypto_mkem_keypair(pks[0], sks[0], seed);
+  }
+  print_bench("\\mgendrbgcyc",0,KYBER_K,t,NRUNS);
+
+  for(i=0;i<NRUNS;i++) {
+    t[i] = cpucycles();
+    crypto_mkem_enc(c1, c2s, key_a, seed, 1, pks);
+  }
+  print_bench("\\mencdrbgcyc",1,KYBER_K,t,NRUNS);
+  randombytes_select(RANDOMBYTES_SYSTEM);
+
+  for(i=0;i<MAXBATCH;i++)
+  {
+    free(c1s[i]);
+    free(sss[i]);
+  }
+
   for(i=0;i<MAXUSERS;i++)
   {
     free(pks[i]);
@@ -198,3 +198,29 @@ void shake256x4(uint8_t *out0,
     }
   }
 }
+
+void sha3_256x4(uint8_t h0[32],
+                uint8_t h1[32],
+                uint8_t h2[32],
+                uint8_t h3[32],
+                const uint8_t *in0,
+                const uint8_t *in1,
+                const uint8_t *in2,
+                const uint8_t *in3,
+                size_t inlen)
+{
+  unsigned int i;
+  __m128d t;
+  __m256i s[25];
+
+  keccakx4_absorb_once(s, SHA3_256_RATE, in0, in1, in2, in3, inlen, 0x06);
+  KeccakF1600_StatePermute4x(s);
+  for(i = 0; i < 4; ++i) {
+    t = _mm_castsi128_pd(_mm256_castsi256_si128(s[i]));
+    _mm_storel_pd((__attribute__((__may_alias__)) double *)&h0[8*i], t);
+    _mm_storeh_pd((__attribute__((__may_alias__)) double *)&h1[8*i], t);
+    t = _mm_castsi128_pd(_mm256_extracti128_si256(s[i],1));
+    _mm_storel_pd((__attribute__((__may_alias__)) double *)&h2[8*i], t);
+    _mm_storeh_pd((__attribute__((__may_alias__)) double *)&h3[8*i], t);
+  }
+}
@@ -0,0 +1,229 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+#include "fips202.h"
+#include "fips202x8.h"
+
+#ifdef KYBER_KECCAK8X
+
+static const uint64_t KeccakF_RoundConstants[24] = {
+  0x0000000000000001ULL, 0x0000000000008082ULL,
+  0x800000000000808aULL, 0x8000000080008000ULL,
+  0x000000000000808bULL, 0x0000000080000001ULL,
+  0x8000000080008081ULL, 0x8000000000008009ULL,
+  0x000000000000008aULL, 0x0000000000000088ULL,
+  0x0000000080008009ULL, 0x000000008000000aULL,
+  0x000000008000808bULL, 0x800000000000008bULL,
+  0x8000000000008089ULL, 0x8000000000008003ULL,
+  0x8000000000008002ULL, 0x8000000000000080ULL,
+  0x000000000000800aULL, 0x800000008000000aULL,
+  0x8000000080008081ULL, 0x8000000000008080ULL,
+  0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/* Rotation offsets of rho, indexed by x+5*y */
+static const uint8_t KeccakF_RhoOffsets[25] = {
+   0,  1, 62, 28, 27,
+  36, 44,  6, 55, 20,
+   3, 10, 43, 25, 39,
+  41, 45, 15, 21,  8,
+  18,  2, 61, 56, 14
+};
+
+/*************************************************
+* Name:        KeccakF1600_StatePermute8x
+*
+* Description: Keccak-f[1600] on eight interleaved states; 64-bit lane
+*              j of s[x+5*y] is lane (x,y) of state j. The three-input
+*              XORs of theta and the chi step use vpternlogq.
+*
+* Arguments:   - __m512i *s: pointer to input/output states
+**************************************************/
+static void KeccakF1600_StatePermute8x(__m512i s[25])
+{
+  unsigned int round, x, y;
+  __m512i b[25], c[5], d[5], t;
+
+  for(round = 0; round < 24; ++round) {
+    /* theta */
+    for(x = 0; x < 5; ++x) {
+      c[x] = _mm512_ternarylogic_epi64(s[x], s[x+5], s[x+10], 0x96);
+      c[x] = _mm512_ternarylogic_epi64(c[x], s[x+15], s[x+20], 0x96);
+    }
+    for(x = 0; x < 5; ++x)
+      d[x] = _mm512_rol_epi64(c[(x+1)%5], 1);
+
+    /* theta applied together with rho and pi */
+    for(y = 0; y < 5; ++y) {
+      for(x = 0; x < 5; ++x) {
+        t = _mm512_ternarylogic_epi64(s[x+5*y], c[(x+4)%5], d[x], 0x96);
+        b[y+5*((2*x+3*y)%5)] = _mm512_rolv_epi64(t, _mm512_set1_epi64(KeccakF_RhoOffsets[x+5*y]));
+      }
+    }
+
+    /* chi: a ^ (~b & c) */
+    for(y = 0; y < 5; ++y)
+      for(x = 0; x < 5; ++x)
+        s[x+5*y] = _mm512_ternarylogic_epi64(b[x+5*y], b[(x+1)%5+5*y], b[(x+2)%5+5*y], 0xD2);
+
+    /* iota */
+    s[0] = _mm512_xor_si512(s[0], _mm512_set1_epi64(KeccakF_RoundConstants[round]));
+  }
+}
+
+static void keccakx8_absorb_once(__m512i s[25],
+                                 unsigned int r,
+                                 const uint8_t *const in[8],
+                                 size_t inlen,
+                                 uint8_t p)
+{
+  size_t i;
+  uint64_t pos = 0;
+  __m512i t, idx;
+
+  for(i = 0; i < 25; ++i)
+    s[i] = _mm512_setzero_si512();
+
+  idx = _mm512_loadu_si512((const void *)in);
+  while(inlen >= r) {
+    for(i = 0; i < r/8; ++i) {
+      t = _mm512_i64gather_epi64(idx, (const void *)pos, 1);
+      s[i] = _mm512_xor_si512(s[i], t);
+      pos += 8;
+    }
+    inlen -= r;
+
+    KeccakF1600_StatePermute8x(s);
+  }
+
+  for(i = 0; i < inlen/8; ++i) {
+    t = _mm512_i64gather_epi64(idx, (const void *)pos, 1);
+    s[i] = _mm512_xor_si512(s[i], t);
+    pos += 8;
+  }
+  inlen -= 8*i;
+
+  if(inlen) {
+    t = _mm512_i64gather_epi64(idx, (const void *)pos, 1);
+    idx = _mm512_set1_epi64((1ULL << (8*inlen)) - 1);
+    t = _mm512_and_si512(t, idx);
+    s[i] = _mm512_xor_si512(s[i], t);
+  }
+
+  t = _mm512_set1_epi64((uint64_t)p << 8*inlen);
+  s[i] = _mm512_xor_si512(s[i], t);
+  t = _mm512_set1_epi64(1ULL << 63);
+  s[r/8 - 1] = _mm512_xor_si512(s[r/8 - 1], t);
+}
+
+static void keccakx8_squeezeblocks(uint8_t *const out[8],
+                                   size_t nblocks,
+                                   unsigned int r,
+                                   __m512i s[25])
+{
+  unsigned int i;
+  uint64_t pos = 0;
+  __m512i idx;
+
+  idx = _mm512_loadu_si512((const void *)out);
+  while(nblocks > 0) {
+    KeccakF1600_StatePermute8x(s);
+    for(i=0; i < r/8; ++i) {
+      _mm512_i64scatter_epi64((void *)pos, idx, s[i], 1);
+      pos += 8;
+    }
+    --nblocks;
+  }
+}
+
+void shake128x8_absorb_once(keccakx8_state *state,
+                            const uint8_t *const in[8],
+                            size_t inlen)
+{
+  keccakx8_absorb_once(state->s, SHAKE128_RATE, in, inlen, 0x1F);
+}
+
+void shake128x8_squeezeblocks(uint8_t *const out[8],
+                              size_t nblocks,
+                              keccakx8_state *state)
+{
+  keccakx8_squeezeblocks(out, nblocks, SHAKE128_RATE, state->s);
+}
+
+void shake256x8_absorb_once(keccakx8_state *state,
+                            const uint8_t *const in[8],
+                            size_t inlen)
+{
+  keccakx8_absorb_once(state->s, SHAKE256_RATE, in, inlen, 0x1F);
+}
+
+void shake256x8_squeezeblocks(uint8_t *const out[8],
+                              size_t nblocks,
+                              keccakx8_state *state)
+{
+  keccakx8_squeezeblocks(out, nblocks, SHAKE256_RATE, state->s);
+}
+
+static void keccakx8(uint8_t *const out[8],
+                     size_t outlen,
+                     unsigned int r,
+                     const uint8_t *const in[8],
+                     size_t inlen)
+{
+  unsigned int i, j;
+  size_t nblocks = outlen/r;
+  uint8_t t[8][SHAKE128_RATE];
+  uint8_t *o[8], *tp[8];
+  keccakx8_state state;
+
+  keccakx8_absorb_once(state.s, r, in, inlen, 0x1F);
+  keccakx8_squeezeblocks(out, nblocks, r, state.s);
+
+  outlen -= nblocks*r;
+  if(outlen) {
+    for(j = 0; j < 8; ++j) {
+      o[j] = out[j] + nblocks*r;
+      tp[j] = t[j];
+    }
+    keccakx8_squeezeblocks(tp, 1, r, state.s);
+    for(j = 0; j < 8; ++j)
+      for(i = 0; i < outlen; ++i)
+        o[j][i] = t[j][i];
+  }
+}
+
+void shake128x8(uint8_t *const out[8],
+                size_t outlen,
+                const uint8_t *const in[8],
+                size_t inlen)
+{
+  keccakx8(out, outlen, SHAKE128_RATE, in, inlen);
+}
+
+void shake256x8(uint8_t *const out[8],
+                size_t outlen,
+                const uint8_t *const in[8],
+                size_t inlen)
+{
+  keccakx8(out, outlen, SHAKE256_RATE, in, inlen);
+}
+
+void sha3_256x8(uint8_t *const h[8],
+                const uint8_t *const in[8],
+                size_t inlen)
+{
+  unsigned int i;
+  uint64_t pos = 0;
+  __m512i s[25], idx;
+
+  keccakx8_absorb_once(s, SHA3_256_RATE, in, inlen, 0x06);
+  KeccakF1600_StatePermute8x(s);
+
+  idx = _mm512_loadu_si512((const void *)h);
+  for(i = 0; i < 4; ++i) {
+    _mm512_i64scatter_epi64((void *)pos, idx, s[i], 1);
+    pos += 8;
+  }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef FIPS202X8_H
+#define FIPS202X8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+/* The 8-way Keccak is built whenever the compiler targets AVX-512F;
+ * define KYBER_NO_KECCAK8X to keep the 4-way code paths only. */
+#if defined(__AVX512F__) && !defined(KYBER_NO_KECCAK8X)
+#define KYBER_KECCAK8X
+
+#define FIPS202X8_NAMESPACE(s) pqcrystals_kyber_fips202x8_avx512_##s
+
+typedef struct {
+  __m512i s[25];
+} keccakx8_state;
+
+#define shake128x8_absorb_once FIPS202X8_NAMESPACE(shake128x8_absorb_once)
+void shake128x8_absorb_once(keccakx8_state *state,
+                            const uint8_t *const in[8],
+                            size_t inlen);
+
+#define shake128x8_squeezeblocks FIPS202X8_NAMESPACE(shake128x8_squeezeblocks)
+void shake128x8_squeezeblocks(uint8_t *const out[8],
+                              size_t nblocks,
+                              keccakx8_state *state);
+
+#define shake256x8_absorb_once FIPS202X8_NAMESPACE(shake256x8_absorb_once)
+void shake256x8_absorb_once(keccakx8_state *state,
+                            const uint8_t *const in[8],
+                            size_t inlen);
+
+#define shake256x8_squeezeblocks FIPS202X8_NAMESPACE(shake256x8_squeezeblocks)
+void shake256x8_squeezeblocks(uint8_t *const out[8],
+                              size_t nblocks,
+                              keccakx8_state *state);
+
+#define shake128x8 FIPS202X8_NAMESPACE(shake128x8)
+void shake128x8(uint8_t *const out[8],
+                size_t outlen,
+                const uint8_t *const in[8],
+                size_t inlen);
+
+#define shake256x8 FIPS202X8_NAMESPACE(shake256x8)
+void shake256x8(uint8_t *const out[8],
+                size_t outlen,
+                const uint8_t *const in[8],
+                size_t inlen);
+
+#define sha3_256x8 FIPS202X8_NAMESPACE(sha3_256x8)
+void sha3_256x8(uint8_t *const h[8],
+                const uint8_t *const in[8],
+                size_t inlen);
+
+#endif
+
+#endif
@@ -12,6 +12,7 @@
 #include "uniform.h"
 #include "symmetric.h"
 #include "randombytes.h"
+#include "profile.h"
 
 #include "debug.h"
 
@@ -37,6 +38,24 @@ static void unpack_pk(polyvec *pk0, polyvec *pk1,
   polyvec_reduce(pk1); //XXX: Only for debugging purposes
 }
 
+static void unpack_pk_4x(polyvec pk0[4], polyvec pk1[4],
+                         const uint8_t *const packedpk[4])
+{
+  int i, j;
+  for(j=0;j<4;j++)
+    polyvec_frombytes(&pk0[j], packedpk[j]);
+  gen_polyvec_4x(&pk1[0], &pk1[1], &pk1[2], &pk1[3],
+                 packedpk[0]+KYBER_POLYVECBYTES, packedpk[1]+KYBER_POLYVECBYTES,
+                 packedpk[2]+KYBER_POLYVECBYTES, packedpk[3]+KYBER_POLYVECBYTES);
+  for(j=0;j<4;j++) {
+    for(i=0;i<KYBER_K;i++)
+      poly_nttunpack(&pk1[j].vec[i]);
+
+    polyvec_add(&pk1[j], &pk1[j], &pk0[j]);
+    polyvec_reduce(&pk1[j]);
+  }
+}
+
 static void pack_sk(uint8_t r[MKYBER_INDCPA_SECRETKEYBYTES], polyvec *sk, uint8_t b)
 {
   polyvec_tobytes(r, sk);
@@ -50,37 +69,80 @@ static void unpack_sk(polyvec *sk, uint8_t *b, const uint8_t packedsk[MKYBER_IND
 }
 
 
+#if defined(KYBER_KECCAK8X) && KYBER_K != 2
 /*************************************************
-* Name:        indcpa_mkeypair
+* Name:        getnoise_eta2_8x
 *
-* Description: Generates public and private key for the CPA-secure
-*              public-key encryption scheme underlying Kyber
+* Description: Samples eight noise polynomials from one seed with
+*              consecutive nonces on the AVX-512 Keccak. Only used for
+*              KYBER_K = 3 and 4, where KYBER_ETA1 = KYBER_ETA2 = 2.
+*
+* Arguments:   - poly **r: array of 8 pointers to output polynomials
+*              - const uint8_t *seed: pointer to input seed
+*                                     (of length KYBER_SYMBYTES bytes)
+*              - uint8_t nonce: nonce of the first polynomial
+**************************************************/
+static void getnoise_eta2_8x(poly *const r[8],
+                             const uint8_t seed[KYBER_SYMBYTES],
+                             uint8_t nonce)
+{
+  unsigned int j;
+  const uint8_t *seeds[8];
+  uint8_t nonces[8];
+
+  for(j=0;j<8;j++) {
+    seeds[j] = seed;
+    nonces[j] = nonce+j;
+  }
+  poly_getnoise_eta2_8x(r, seeds, nonces);
+}
+#endif
+
+/*************************************************
+* Name:        mkeypair
+*
+* Description: Deterministic part of key generation shared by
+*              indcpa_mkeypair and indcpa_mkeypair_4x
 *
 * Arguments:   - uint8_t *pk: pointer to output public key
 *                             (of length MKYBER_INDCPA_PUBLICKEYBYTES bytes)
 *              - uint8_t *sk: pointer to output private key
                               (of length MKYBER_INDCPA_SECRETKEYBYTES bytes)
-*              - const uint8_t *publicseed: pointer to input public seed
+*              - const polyvec *a: pointer to expanded matrix A
+*              - const uint8_t *noiseseed: pointer to noise seed
+*                             (of length KYBER_SYMBYTES+1)
+*              - polyvec *fakepkpv: pointer to fake public key as expanded
+*                             by gen_polyvec (overwritten)
+*              - const uint8_t *fakepkseed: pointer to seed of the fake public key
 *                             (of length KYBER_SYMBYTES)
 **************************************************/
-void indcpa_mkeypair(uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
+static void mkeypair(uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
                      uint8_t sk[MKYBER_INDCPA_SECRETKEYBYTES],
-                     const uint8_t publicseed[KYBER_SYMBYTES])
+                     const polyvec a[KYBER_K],
+                     const uint8_t noiseseed[KYBER_SYMBYTES+1],
+                     polyvec *fakepkpv,
+                     const uint8_t fakepkseed[KYBER_SYMBYTES])
 {
   unsigned int i;
-  uint8_t noiseseed[KYBER_SYMBYTES+1]; /* Additional byte to set random order of public keys */
-  uint8_t fakepkseed[KYBER_SYMBYTES];
-  polyvec a[KYBER_K], e, pkpv, fakepkpv, skpv;
-
-  randombytes(noiseseed, KYBER_SYMBYTES+1);
-
-  gen_a(a, publicseed);
+  polyvec e, pkpv, skpv;
 
 #if KYBER_K == 2
   poly_getnoise_eta1_4x(skpv.vec+0, skpv.vec+1, e.vec+0, e.vec+1, noiseseed, 0, 1, 2, 3);
+#elif KYBER_K == 3 && defined(KYBER_KECCAK8X)
+  {
+    poly *const r[8] = {skpv.vec+0, skpv.vec+1, skpv.vec+2, e.vec+0,
+                        e.vec+1, e.vec+2, pkpv.vec+0, pkpv.vec+1};
+    getnoise_eta2_8x(r, noiseseed, 0);
+  }
 #elif KYBER_K == 3
   poly_getnoise_eta1_4x(skpv.vec+0, skpv.vec+1, skpv.vec+2, e.vec+0, noiseseed, 0, 1, 2, 3);
   poly_getnoise_eta1_4x(e.vec+1, e.vec+2, pkpv.vec+0, pkpv.vec+1, noiseseed, 4, 5, 6, 7);
+#elif KYBER_K == 4 && defined(KYBER_KECCAK8X)
+  {
+    poly *const r[8] = {skpv.vec+0, skpv.vec+1, skpv.vec+2, skpv.vec+3,
+                        e.vec+0, e.vec+1, e.vec+2, e.vec+3};
+    getnoise_eta2_8x(r, noiseseed, 0);
+  }
 #elif KYBER_K == 4
   poly_getnoise_eta1_4x(skpv.vec+0, skpv.vec+1, skpv.vec+2, skpv.vec+3, noiseseed,  0, 1, 2, 3);
   poly_getnoise_eta1_4x(e.vec+0, e.vec+1, e.vec+2, e.vec+3, noiseseed, 4, 5, 6, 7);
@@ -100,20 +162,105 @@ void indcpa_mkeypair(uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
   polyvec_add(&pkpv, &pkpv, &e);
   polyvec_reduce(&pkpv);
 
+  for(i=0;i<KYBER_K;i++)
+    poly_nttunpack(&fakepkpv->vec[i]);
+
+  polyvec_sub(fakepkpv, &pkpv, fakepkpv);
+  polyvec_reduce(fakepkpv);
+
+  polyvec_cmov(&pkpv, fakepkpv, noiseseed[KYBER_SYMBYTES]&1);
+
+  pack_sk(sk, &skpv, noiseseed[KYBER_SYMBYTES]&1);
+  pack_pk(pk, &pkpv, fakepkseed);
+}
+
+/*************************************************
+* Name:        indcpa_mkeypair
+*
+* Description: Generates public and private key for the CPA-secure
+*              public-key encryption scheme underlying Kyber
+*
+* Arguments:   - uint8_t *pk: pointer to output public key
+*                             (of length MKYBER_INDCPA_PUBLICKEYBYTES bytes)
+*              - uint8_t *sk: pointer to output private key
+                              (of length MKYBER_INDCPA_SECRETKEYBYTES bytes)
+*              - const uint8_t *publicseed: pointer to input public seed
+*                             (of length KYBER_SYMBYTES)
+**************************************************/
+void indcpa_mkeypair(uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
+                     uint8_t sk[MKYBER_INDCPA_SECRETKEYBYTES],
+                     const uint8_t publicseed[KYBER_SYMBYTES])
+{
+  uint8_t noiseseed[KYBER_SYMBYTES+1]; /* Additional byte to set random order of public keys */
+  uint8_t fakepkseed[KYBER_SYMBYTES];
+  polyvec a[KYBER_K], fakepkpv;
+
+  randombytes(noiseseed, KYBER_SYMBYTES+1);
+
+  gen_a(a, publicseed);
+
   randombytes(fakepkseed, KYBER_SYMBYTES);
   /* Don't release system RNG output */
   hash_h(fakepkseed, fakepkseed, KYBER_SYMBYTES);
   gen_polyvec(&fakepkpv, fakepkseed);
-  for(i=0;i<KYBER_K;i++)
-    poly_nttunpack(&fakepkpv.vec[i]);
 
-  polyvec_sub(&fakepkpv, &pkpv, &fakepkpv);
-  polyvec_reduce(&fakepkpv);
+  mkeypair(pk, sk, a, noiseseed, &fakepkpv, fakepkseed);
+}
 
-  polyvec_cmov(&pkpv, &fakepkpv, noiseseed[KYBER_SYMBYTES]&1);
+/*************************************************
+* Name:        indcpa_mkeypair_4x
+*
+* Description: Generates four key pairs for the same public matrix from
+*              given randomness; the fake public keys are hashed and
+*              expanded through the 4-way parallel Keccak
+*
+* Arguments:   - uint8_t **pk: array of 4 pointers to output public keys
+*                              (each of length MKYBER_INDCPA_PUBLICKEYBYTES bytes)
+*              - uint8_t **sk: array of 4 pointers to output private keys
+*                              (each of length MKYBER_INDCPA_SECRETKEYBYTES bytes)
+*              - const polyvec *a: pointer to matrix A expanded by gen_matrix
+*              - const uint8_t **coins: array of 4 pointers to randomness
+*                              (each of length MKYBER_INDCPA_KEYPAIRCOINBYTES), in the
+*                              order in which indcpa_mkeypair draws it
+**************************************************/
+void indcpa_mkeypair_4x(uint8_t *const pk[4],
+                        uint8_t *const sk[4],
+                        const polyvec a[KYBER_K],
+                        const uint8_t *const coins[4])
+{
+  unsigned int j;
+  uint8_t fakepkseed[4][KYBER_SYMBYTES];
+  polyvec fakepkpv[4];
 
-  pack_sk(sk, &skpv, noiseseed[KYBER_SYMBYTES]&1);
-  pack_pk(pk, &pkpv, fakepkseed);
+  /* Don't release system RNG output */
+  hash_h4x(fakepkseed[0], fakepkseed[1], fakepkseed[2], fakepkseed[3],
+           coins[0]+KYBER_SYMBYTES+1, coins[1]+KYBER_SYMBYTES+1,
+           coins[2]+KYBER_SYMBYTES+1, coins[3]+KYBER_SYMBYTES+1, KYBER_SYMBYTES);
+  gen_polyvec_4x(&fakepkpv[0], &fakepkpv[1], &fakepkpv[2], &fakepkpv[3],
+                 fakepkseed[0], fakepkseed[1], fakepkseed[2], fakepkseed[3]);
+
+  for(j=0;j<4;j++)
+    mkeypair(pk[j], sk[j], a, coins[j], &fakepkpv[j], fakepkseed[j]);
+}
+
+/*************************************************
+* Name:        indcpa_seedctx_init
+*
+* Description: Expands the transposed matrix A^T for a public seed once,
+*              for reuse by indcpa_enc_c1_ctx
+*
+* Arguments:   - indcpa_seedctx *ctx: pointer to output seed context
+*              - const uint8_t *seed: pointer to input public seed
+*                                  (of length KYBER_SYMBYTES bytes)
+**************************************************/
+void indcpa_seedctx_init(indcpa_seedctx *ctx,
+                         const uint8_t seed[KYBER_SYMBYTES])
+{
+  PROFILE_START(t);
+
+  memcpy(ctx->seed, seed, KYBER_SYMBYTES);
+  gen_at(ctx->at, seed);
+  PROFILE_LAP(t, MKEM_PROFILE_MATRIX);
 }
 
 /*************************************************
@@ -137,55 +284,314 @@ void indcpa_enc_c1(uint8_t c1[MKYBER_C1BYTES],
                    uint8_t fwd[MKYBER_FWDBYTES],
                    const uint8_t seed[KYBER_SYMBYTES],
                    const uint8_t coins[KYBER_SYMBYTES])
+{
+  indcpa_seedctx ctx;
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_ctx(c1, fwd, &ctx, coins);
+}
+
+/*************************************************
+* Name:        indcpa_enc_c1_ctx
+*
+* Description: Same as indcpa_enc_c1, but takes the matrix from a
+*              seed context instead of expanding it from the seed
+*
+* Arguments:   - uint8_t *c1: pointer to output ciphertext component
+*                             (of length MKYBER_C1BYTES bytes)
+*              - uint8_t *fwd: pointer to (secret) information that is forwarded
+*                              to enc_c2 (of length MKYBER_FWDBYTES)
+*              - const indcpa_seedctx *ctx: pointer to input seed context
+*              - const uint8_t *coins: pointer to input random coins used as seed
+*                                      (of length KYBER_SYMBYTES) to deterministically
+*                                      generate all randomness
+**************************************************/
+void indcpa_enc_c1_ctx(uint8_t c1[MKYBER_C1BYTES],
+                       uint8_t fwd[MKYBER_FWDBYTES],
+                       const indcpa_seedctx *ctx,
+                       const uint8_t coins[KYBER_SYMBYTES])
+{
+  indcpa_fwd tfwd;
+
+  indcpa_enc_c1_fwd(c1, &tfwd, ctx, coins);
+  indcpa_fwd_tobytes(fwd, &tfwd);
+}
+
+/*************************************************
+* Name:        indcpa_enc_c1_fwd
+*
+* Description: Same as indcpa_enc_c1_ctx, but keeps the forwarded
+*              information as unpacked polynomial vectors in NTT domain,
+*              also prepared as basemul operands for indcpa_enc_c2_fwd
+*
+* Arguments:   - uint8_t *c1: pointer to output ciphertext component
+*                             (of length MKYBER_C1BYTES bytes)
+*              - indcpa_fwd *fwd: pointer to output (secret) information
+*                                 that is forwarded to enc_c2
+*              - const indcpa_seedctx *ctx: pointer to input seed context
+*              - const uint8_t *coins: pointer to input random coins used as seed
+*                                      (of length KYBER_SYMBYTES) to deterministically
+*                                      generate all randomness
+**************************************************/
+void indcpa_enc_c1_fwd(uint8_t c1[MKYBER_C1BYTES],
+                       indcpa_fwd *fwd,
+                       const indcpa_seedctx *ctx,
+                       const uint8_t coins[KYBER_SYMBYTES])
 {
   unsigned int i;
-  polyvec sp0, sp1, ep0, ep1, at[KYBER_K], b0, b1;
+  polyvec ep0, ep1, b0, b1;
+  polyvec *sp0 = &fwd->sp0, *sp1 = &fwd->sp1;
+  const polyvec *at = ctx->at;
   uint8_t tbuf[KYBER_POLYVECCOMPRESSEDBYTES+2];
-
-  gen_at(at, seed);
+  PROFILE_START(t);
 
   #if KYBER_K == 2
-  poly_getnoise_eta1_4x(sp0.vec+0, sp0.vec+1, sp1.vec+0, sp1.vec+1, coins,  0, 1, 2, 3);
+  poly_getnoise_eta1_4x(sp0->vec+0, sp0->vec+1, sp1->vec+0, sp1->vec+1, coins,  0, 1, 2, 3);
   poly_getnoise_eta2_4x(ep0.vec+0, ep0.vec+1, ep1.vec+0, ep1.vec+1, coins,  4, 5, 6, 7);
+  #elif KYBER_K == 3 && defined(KYBER_KECCAK8X)
+  {
+    poly *const r[8] = {sp0->vec+0, sp0->vec+1, sp0->vec+2, sp1->vec+0,
+                        sp1->vec+1, sp1->vec+2, ep0.vec+0, ep0.vec+1};
+    getnoise_eta2_8x(r, coins, 0);
+  }
+  poly_getnoise_eta1_4x(ep0.vec+2, ep1.vec+0, ep1.vec+1, ep1.vec+2, coins,  8, 9, 10, 11);
   #elif KYBER_K == 3
-  poly_getnoise_eta1_4x(sp0.vec+0, sp0.vec+1, sp0.vec+2, sp1.vec+0, coins,  0, 1, 2, 3);
-  poly_getnoise_eta1122_4x(sp1.vec+1, sp1.vec+2, ep0.vec+0, ep0.vec+1, coins,  4, 5, 6, 7);
+  poly_getnoise_eta1_4x(sp0->vec+0, sp0->vec+1, sp0->vec+2, sp1->vec+0, coins,  0, 1, 2, 3);
+  poly_getnoise_eta1122_4x(sp1->vec+1, sp1->vec+2, ep0.vec+0, ep0.vec+1, coins,  4, 5, 6, 7);
   poly_getnoise_eta1_4x(ep0.vec+2, ep1.vec+0, ep1.vec+1, ep1.vec+2, coins,  8, 9, 10, 11);
+  #elif KYBER_K == 4 && defined(KYBER_KECCAK8X)
+  {
+    poly *const r0[8] = {sp0->vec+0, sp0->vec+1, sp0->vec+2, sp0->vec+3,
+                         sp1->vec+0, sp1->vec+1, sp1->vec+2, sp1->vec+3};
+    poly *const r1[8] = {ep0.vec+0, ep0.vec+1, ep0.vec+2, ep0.vec+3,
+                         ep1.vec+0, ep1.vec+1, ep1.vec+2, ep1.vec+3};
+    getnoise_eta2_8x(r0, coins, 0);
+    getnoise_eta2_8x(r1, coins, 8);
+  }
   #elif KYBER_K == 4
-  poly_getnoise_eta1_4x(sp0.vec+0, sp0.vec+1, sp0.vec+2, sp0.vec+3, coins,  0, 1, 2, 3);
-  poly_getnoise_eta1_4x(sp1.vec+0, sp1.vec+1, sp1.vec+2, sp1.vec+3, coins,  4, 5, 6, 7);
+  poly_getnoise_eta1_4x(sp0->vec+0, sp0->vec+1, sp0->vec+2, sp0->vec+3, coins,  0, 1, 2, 3);
+  poly_getnoise_eta1_4x(sp1->vec+0, sp1->vec+1, sp1->vec+2, sp1->vec+3, coins,  4, 5, 6, 7);
   poly_getnoise_eta2_4x(ep0.vec+0, ep0.vec+1, ep0.vec+2, ep0.vec+3, coins,  8, 9, 10, 11);
   poly_getnoise_eta2_4x(ep1.vec+0, ep1.vec+1, ep1.vec+2, ep1.vec+3, coins,  12, 13, 14, 15);
   #endif
-
-  polyvec_ntt(&sp0);
-  polyvec_ntt(&sp1);
-  polyvec_reduce(&sp0);
-  polyvec_reduce(&sp1);
+  PROFILE_LAP(t, MKEM_PROFILE_NOISE);
+
+  polyvec_ntt(sp0);
+  polyvec_ntt(sp1);
+  polyvec_reduce(sp0);
+  polyvec_reduce(sp1);
+  PROFILE_LAP(t, MKEM_PROFILE_NTT);
+  polyvec_basemul_prepare(&fwd->spp0, sp0);
+  polyvec_basemul_prepare(&fwd->spp1, sp1);
  
-  // matrix-vector multiplication
-  for(i=0;i<KYBER_K;i++)
-    polyvec_basemul_acc_montgomery(&b0.vec[i], &at[i], &sp0);
- 
-  // matrix-vector multiplication
+  // matrix-vector multiplication with both vectors, one pass over at
   for(i=0;i<KYBER_K;i++)
-    polyvec_basemul_acc_montgomery(&b1.vec[i], &at[i], &sp1);
- 
-  polyvec_invntt_tomont(&b0);
-  polyvec_add(&b0, &b0, &ep0);
-  polyvec_reduce(&b0);
-  
-  polyvec_compress(c1, &b0);
+    polyvec_basemul_acc_montgomery_2x(&b0.vec[i], &b1.vec[i], &at[i], sp0, sp1);
+  PROFILE_LAP(t, MKEM_PROFILE_BASEMUL);
 
-  polyvec_invntt_tomont(&b1);
-  polyvec_add(&b1, &b1, &ep1);
-  polyvec_reduce(&b1);
+  polyvec_invntt_add_compress(c1, &b0, &ep0);
+  polyvec_invntt_add_compress(tbuf, &b1, &ep1);
+  memcpy(c1+KYBER_POLYVECCOMPRESSEDBYTES, tbuf, KYBER_POLYVECCOMPRESSEDBYTES);
+  PROFILE_LAP(t, MKEM_PROFILE_COMPRESS);
+}
 
-  polyvec_tobytes(fwd, &sp0);
-  polyvec_tobytes(fwd+KYBER_POLYVECBYTES, &sp1);
+/*************************************************
+* Name:        indcpa_fwd_tobytes
+*
+* Description: Serializes forwarded information
+*
+* Arguments:   - uint8_t *r: pointer to output byte array
+*                            (of length MKYBER_FWDBYTES)
+*              - const indcpa_fwd *fwd: pointer to input forwarded information
+**************************************************/
+void indcpa_fwd_tobytes(uint8_t r[MKYBER_FWDBYTES], const indcpa_fwd *fwd)
+{
+  polyvec_tobytes(r, &fwd->sp0);
+  polyvec_tobytes(r+KYBER_POLYVECBYTES, &fwd->sp1);
+}
+
+/*************************************************
+* Name:        indcpa_fwd_frombytes
+*
+* Description: De-serializes forwarded information;
+*              inverse of indcpa_fwd_tobytes
+*
+* Arguments:   - indcpa_fwd *fwd: pointer to output forwarded information
+*              - const uint8_t *a: pointer to input byte array
+*                                  (of length MKYBER_FWDBYTES)
+**************************************************/
+void indcpa_fwd_frombytes(indcpa_fwd *fwd, const uint8_t a[MKYBER_FWDBYTES])
+{
+  polyvec_frombytes(&fwd->sp0, a);
+  polyvec_frombytes(&fwd->sp1, a+KYBER_POLYVECBYTES);
+  polyvec_basemul_prepare(&fwd->spp0, &fwd->sp0);
+  polyvec_basemul_prepare(&fwd->spp1, &fwd->sp1);
+}
+
+static void getnoise_c2(poly *epp0, poly *epp1, uint8_t *flippks,
+                        const uint8_t coins2[KYBER_SYMBYTES])
+{
+  uint8_t tcoins2[KYBER_SYMBYTES];
+
+  memcpy(tcoins2, coins2, KYBER_SYMBYTES);
+  *flippks = tcoins2[0] & 1;
+  tcoins2[0] &= 0xfe;  /* Take one bit of coins to decide whether to flip or not */
+
+  poly_getnoise_eta2(epp0, tcoins2, 0); /* used to encaps to first pk */
+  poly_getnoise_eta2(epp1, tcoins2, 1); /* used to encaps to second pk */
+}
+
+static void getnoise_c2_4x(poly epp0[4], poly epp1[4], uint8_t flippks[4],
+                           const uint8_t coins2[4][KYBER_SYMBYTES])
+{
+  unsigned int j;
+  uint8_t tcoins2[4][KYBER_SYMBYTES];
+
+  for(j=0;j<4;j++) {
+    memcpy(tcoins2[j], coins2[j], KYBER_SYMBYTES);
+    flippks[j] = tcoins2[j][0] & 1;
+    tcoins2[j][0] &= 0xfe;
+  }
+
+#ifdef KYBER_KECCAK8X
+  {
+    poly *const r[8] = {&epp0[0], &epp1[0], &epp0[1], &epp1[1],
+                        &epp0[2], &epp1[2], &epp0[3], &epp1[3]};
+    const uint8_t *const seeds[8] = {tcoins2[0], tcoins2[0], tcoins2[1], tcoins2[1],
+                                     tcoins2[2], tcoins2[2], tcoins2[3], tcoins2[3]};
+    const uint8_t nonces[8] = {0, 1, 0, 1, 0, 1, 0, 1};
+    poly_getnoise_eta2_8x(r, seeds, nonces);
+  }
+#else
+  poly_getnoise_eta2_4x_multiseed(&epp0[0], &epp1[0], &epp0[1], &epp1[1],
+                                  tcoins2[0], tcoins2[0], tcoins2[1], tcoins2[1],
+                                  0, 1, 0, 1);
+  poly_getnoise_eta2_4x_multiseed(&epp0[2], &epp1[2], &epp0[3], &epp1[3],
+                                  tcoins2[2], tcoins2[2], tcoins2[3], tcoins2[3],
+                                  0, 1, 0, 1);
+#endif
+}
+
+/*************************************************
+* Name:        enc_c2_compress
+*
+* Description: Finishes the public-key dependent part of encryption
+*              from the two inner products v[0], v[1] after the inverse NTT
+*
+* Arguments:   - uint8_t *c2: pointer to output ciphertext component
+*                             (of length MKYBER_C2BYTES bytes)
+*              - const poly *k: pointer to message polynomial
+*              - poly *v: pointer to the two inner products (overwritten)
+*              - const poly *epp0, *epp1: pointers to public-key dependent noise
+*              - uint8_t flippks: bit deciding the order of the public keys
+**************************************************/
+static void enc_c2_compress(uint8_t c2[MKYBER_C2BYTES],
+                            const poly *k,
+                            poly v[2],
+                            const poly *epp0,
+                            const poly *epp1,
+                            uint8_t flippks)
+{
+  /* Encaps to first pk */
+  poly_add(&v[0], &v[0], epp0);
+  poly_add(&v[0], &v[0], k);
+  poly_reduce(&v[0]);
+
+  poly_compress(c2, &v[0]);
   
-  polyvec_compress(tbuf, &b1);
-  memcpy(c1+KYBER_POLYVECCOMPRESSEDBYTES, tbuf, KYBER_POLYVECCOMPRESSEDBYTES);
+  /* Encaps to second pk */
+  poly_add(&v[1], &v[1], epp1);
+  poly_add(&v[1], &v[1], k);
+  poly_reduce(&v[1]);
+
+  poly_compress(c2+KYBER_POLYCOMPRESSEDBYTES, &v[1]);
+  c2[MKYBER_C2BYTES-1] = flippks;
+}
+
+/*************************************************
+* Name:        enc_c2
+*
+* Description: Public-key dependent part of encryption shared by
+*              all single-recipient indcpa_enc_c2 variants
+*
+* Arguments:   - uint8_t *c2: pointer to output ciphertext component
+*                             (of length MKYBER_C2BYTES bytes)
+*              - const poly *k: pointer to message polynomial
+*              - polyvec *pkpv0, *pkpv1: pointers to unpacked public key
+*                                        (swapped in place if flippks is 1)
+*              - const indcpa_fwd *fwd: pointer to forwarded noise vectors
+*              - const poly *epp0, *epp1: pointers to public-key dependent noise
+*              - uint8_t flippks: bit deciding the order of the public keys
+**************************************************/
+static void enc_c2(uint8_t c2[MKYBER_C2BYTES],
+                   const poly *k,
+                   polyvec *pkpv0,
+                   polyvec *pkpv1,
+                   const indcpa_fwd *fwd,
+                   const poly *epp0,
+                   const poly *epp1,
+                   uint8_t flippks)
+{
+  poly v[2];
+  PROFILE_START(t);
+
+  polyvec_cswap(pkpv0, pkpv1, flippks);
+
+  polyvec_basemul_acc_montgomery_prepared(&v[0], pkpv0, &fwd->spp0);
+  polyvec_basemul_acc_montgomery_prepared(&v[1], pkpv1, &fwd->spp1);
+  PROFILE_LAP(t, MKEM_PROFILE_BASEMUL);
+  poly_invntt_tomont_batch(v, 2);
+  PROFILE_LAP(t, MKEM_PROFILE_NTT);
+
+  enc_c2_compress(c2, k, v, epp0, epp1, flippks);
+  PROFILE_LAP(t, MKEM_PROFILE_COMPRESS);
+}
+
+/*************************************************
+* Name:        enc_c2_4x
+*
+* Description: Recipient-major variant of enc_c2 for four public keys and
+*              the same forwarded noise vectors; the prepared operands of
+*              sp0 (resp. sp1) are shared by two recipients per pass
+*
+* Arguments:   - uint8_t **c2: array of 4 pointers to output ciphertext components
+*              - const poly *k: pointer to message polynomial
+*              - polyvec *pkpv0, *pkpv1: arrays of 4 unpacked public keys
+*                                        (swapped in place if flippks is 1)
+*              - const indcpa_fwd *fwd: pointer to forwarded noise vectors
+*              - const poly *epp0, *epp1: arrays of 4 public-key dependent noise
+*              - const uint8_t *flippks: array of 4 bits deciding the order
+*                                        of the public keys
+**************************************************/
+static void enc_c2_4x(uint8_t *const c2[4],
+                      const poly *k,
+                      polyvec pkpv0[4],
+                      polyvec pkpv1[4],
+                      const indcpa_fwd *fwd,
+                      const poly epp0[4],
+                      const poly epp1[4],
+                      const uint8_t flippks[4])
+{
+  unsigned int j;
+  /* Inner products of recipient j at v[2*j] and v[2*j+1], in one flat
+   * array for the batched inverse NTT */
+  poly v[8];
+  PROFILE_START(t);
+
+  for(j=0;j<4;j++)
+    polyvec_cswap(&pkpv0[j], &pkpv1[j], flippks[j]);
+
+  for(j=0;j<4;j+=2) {
+    polyvec_basemul_acc_montgomery_prepared_2x(&v[2*j+0], &v[2*j+2], &pkpv0[j], &pkpv0[j+1], &fwd->spp0);
+    polyvec_basemul_acc_montgomery_prepared_2x(&v[2*j+1], &v[2*j+3], &pkpv1[j], &pkpv1[j+1], &fwd->spp1);
+  }
+  PROFILE_LAP(t, MKEM_PROFILE_BASEMUL);
+  poly_invntt_tomont_batch(v, 8);
+  PROFILE_LAP(t, MKEM_PROFILE_NTT);
+
+  for(j=0;j<4;j++)
+    enc_c2_compress(c2[j], k, &v[2*j], &epp0[j], &epp1[j], flippks[j]);
+  PROFILE_LAP(t, MKEM_PROFILE_COMPRESS);
 }
 
 /*************************************************
@@ -211,51 +617,263 @@ void indcpa_enc_c2(uint8_t c2[MKYBER_C2BYTES],
                    const uint8_t fwd[MKYBER_FWDBYTES],
                    const uint8_t coins2[KYBER_SYMBYTES])
 {
-  uint8_t nonce = 0;
-  polyvec sp0, sp1, pkpv0, pkpv1;
-  poly v0, v1, k, epp0, epp1;
-  uint8_t tcoins2[KYBER_SYMBYTES];
-  uint8_t flippks;
+  indcpa_fwd tfwd;
 
-  polyvec_frombytes(&sp0, fwd);
-  polyvec_frombytes(&sp1, fwd+KYBER_POLYVECBYTES);
+  indcpa_fwd_frombytes(&tfwd, fwd);
+  indcpa_enc_c2_fwd(c2, msg, pk, &tfwd, coins2);
+}
 
-  memcpy(tcoins2, coins2, KYBER_SYMBYTES);
-  flippks = tcoins2[0] & 1;
-  tcoins2[0] &= 0xfe;  /* Take one bit of coins to decide whether to flip or not */
+/*************************************************
+* Name:        indcpa_enc_c2_fwd
+*
+* Description: Same as indcpa_enc_c2, but takes the forwarded
+*              information as output by indcpa_enc_c1_fwd
+*
+* Arguments:   - uint8_t *c2: pointer to output ciphertext component
+*                             (of length MKYBER_C2BYTES bytes)
+*              - const uint8_t *m: pointer to input plaintext
+*                                  (of length KYBER_INDCPA_MSGBYTES bytes)
+*              - const uint8_t *pk: pointer to input public key
+*                                   (of length MKYBER_INDCPA_PUBLICKEYBYTES bytes)
+*              - const indcpa_fwd *fwd: pointer to (secret) information forwarded
+*                                       from indcpa_enc_c1_fwd
+*              - const uint8_t *coins2: array of public-key dependent coins
+**************************************************/
+void indcpa_enc_c2_fwd(uint8_t c2[MKYBER_C2BYTES],
+                       const uint8_t msg[KYBER_INDCPA_MSGBYTES],
+                       const uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
+                       const indcpa_fwd *fwd,
+                       const uint8_t coins2[KYBER_SYMBYTES])
+{
+  polyvec pkpv0, pkpv1;
+  poly k, epp0, epp1;
+  uint8_t flippks;
+  PROFILE_START(t);
 
-  poly_getnoise_eta2(&epp0, tcoins2, nonce++); /* used to encaps to first pk */
-  poly_getnoise_eta2(&epp1, tcoins2, nonce++); /* used to encaps to second pk */
+  getnoise_c2(&epp0, &epp1, &flippks, coins2);
+  PROFILE_LAP(t, MKEM_PROFILE_NOISE);
 
   poly_frommsg(&k, msg);
   
   unpack_pk(&pkpv0, &pkpv1, pk);
-  polyvec_cswap(&pkpv0, &pkpv1, flippks);
+  PROFILE_LAP(t, MKEM_PROFILE_MATRIX);
 
-  /* Encaps to first pk */
-  polyvec_basemul_acc_montgomery(&v0, &pkpv0, &sp0);
+  enc_c2(c2, &k, &pkpv0, &pkpv1, fwd, &epp0, &epp1, flippks);
+}
 
-  poly_invntt_tomont(&v0);
+/*************************************************
+* Name:        indcpa_enc_c2_4x
+*
+* Description: Four-way interleaved variant of indcpa_enc_c2 for four
+*              public keys and the same message and forwarded information.
+*              Noise sampling and expansion of the fake public keys
+*              run through the 4-way parallel Keccak.
+*
+* Arguments:   - uint8_t **c2: array of 4 pointers to output ciphertext components
+*                              (each of length MKYBER_C2BYTES bytes)
+*              - const uint8_t *m: pointer to input plaintext
+*                                  (of length KYBER_INDCPA_MSGBYTES bytes)
+*              - const uint8_t **pk: array of 4 pointers to input public keys
+*                                    (each of length MKYBER_INDCPA_PUBLICKEYBYTES bytes)
+*              - const indcpa_fwd *fwd: pointer to (secret) information forwarded
+*                                       from indcpa_enc_c1_fwd
+*              - const uint8_t coins2: 4 arrays of public-key dependent coins
+**************************************************/
+void indcpa_enc_c2_4x(uint8_t *const c2[4],
+                      const uint8_t msg[KYBER_INDCPA_MSGBYTES],
+                      const uint8_t *const pk[4],
+                      const indcpa_fwd *fwd,
+                      const uint8_t coins2[4][KYBER_SYMBYTES])
+{
+  polyvec pkpv0[4], pkpv1[4];
+  poly k, epp0[4], epp1[4];
+  uint8_t flippks[4];
+  PROFILE_START(t);
 
-  poly_add(&v0, &v0, &epp0);
-  poly_add(&v0, &v0, &k);
-  poly_reduce(&v0);
+  getnoise_c2_4x(epp0, epp1, flippks, coins2);
+  PROFILE_LAP(t, MKEM_PROFILE_NOISE);
 
-  poly_compress(c2, &v0);
-  
-  /* Encaps to second pk */
-  polyvec_basemul_acc_montgomery(&v1, &pkpv1, &sp1);
+  poly_frommsg(&k, msg);
 
-  poly_invntt_tomont(&v1);
+  unpack_pk_4x(pkpv0, pkpv1, pk);
+  PROFILE_LAP(t, MKEM_PROFILE_MATRIX);
 
-  poly_add(&v1, &v1, &epp1);
-  poly_add(&v1, &v1, &k);
-  poly_reduce(&v1);
+  enc_c2_4x(c2, &k, pkpv0, pkpv1, fwd, epp0, epp1, flippks);
+}
 
-  poly_compress(c2+KYBER_POLYCOMPRESSEDBYTES, &v1);
-  c2[MKYBER_C2BYTES-1] = flippks;
+/*************************************************
+* Name:        indcpa_prepare_pk
+*
+* Description: Unpacks a public key once, including the expansion of
+*              the fake public key, for repeated use with
+*              indcpa_enc_c2_prepared
+*
+* Arguments:   - indcpa_prepared_pk *ppk: pointer to output prepared public key
+*              - const uint8_t *pk: pointer to input public key
+*                                   (of length MKYBER_INDCPA_PUBLICKEYBYTES bytes)
+**************************************************/
+void indcpa_prepare_pk(indcpa_prepared_pk *ppk,
+                       const uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES])
+{
+  unpack_pk(&ppk->pkpv0, &ppk->pkpv1, pk);
+}
+
+/*************************************************
+* Name:        indcpa_check_prepared_pk
+*
+* Description: Checks that all coefficients of a prepared public key lie
+*              in [0,q], the range of the reduced output of
+*              indcpa_prepare_pk for a well-formed public key
+*
+* Arguments:   - const indcpa_prepared_pk *ppk: pointer to prepared public key
+*
+* Returns 0 if all coefficients are in range, -1 otherwise
+**************************************************/
+int indcpa_check_prepared_pk(const indcpa_prepared_pk *ppk)
+{
+  unsigned int i, j;
+  int16_t bad = 0;
+
+  for(i=0;i<KYBER_K;i++)
+    for(j=0;j<KYBER_N;j++) {
+      bad |= (ppk->pkpv0.vec[i].coeffs[j] < 0) | (ppk->pkpv0.vec[i].coeffs[j] > KYBER_Q);
+      bad |= (ppk->pkpv1.vec[i].coeffs[j] < 0) | (ppk->pkpv1.vec[i].coeffs[j] > KYBER_Q);
+    }
+
+  return bad ? -1 : 0;
+}
+
+/*************************************************
+* Name:        indcpa_enc_c2_prepared
+*
+* Description: Same as indcpa_enc_c2, but for a public key that was
+*              unpacked beforehand by indcpa_prepare_pk
+*
+* Arguments:   - uint8_t *c2: pointer to output ciphertext component
+*                             (of length MKYBER_C2BYTES bytes)
+*              - const uint8_t *m: pointer to input plaintext
+*                                  (of length KYBER_INDCPA_MSGBYTES bytes)
+*              - const indcpa_prepared_pk *ppk: pointer to prepared public key
+*              - const indcpa_fwd *fwd: pointer to (secret) information forwarded
+*                                       from indcpa_enc_c1_fwd
+*              - const uint8_t *coins2: array of public-key dependent coins
+**************************************************/
+void indcpa_enc_c2_prepared(uint8_t c2[MKYBER_C2BYTES],
+                            const uint8_t msg[KYBER_INDCPA_MSGBYTES],
+                            const indcpa_prepared_pk *ppk,
+                            const indcpa_fwd *fwd,
+                            const uint8_t coins2[KYBER_SYMBYTES])
+{
+  polyvec pkpv0, pkpv1;
+  poly k, epp0, epp1;
+  uint8_t flippks;
+  PROFILE_START(t);
+
+  getnoise_c2(&epp0, &epp1, &flippks, coins2);
+  PROFILE_LAP(t, MKEM_PROFILE_NOISE);
+
+  poly_frommsg(&k, msg);
+
+  pkpv0 = ppk->pkpv0;
+  pkpv1 = ppk->pkpv1;
+
+  enc_c2(c2, &k, &pkpv0, &pkpv1, fwd, &epp0, &epp1, flippks);
+}
+
+/*************************************************
+* Name:        indcpa_enc_c2_prepared_4x
+*
+* Description: Four-way variant of indcpa_enc_c2_prepared
+*
+* Arguments:   - uint8_t **c2: array of 4 pointers to output ciphertext components
+*                              (each of length MKYBER_C2BYTES bytes)
+*              - const uint8_t *m: pointer to input plaintext
+*                                  (of length KYBER_INDCPA_MSGBYTES bytes)
+*              - const indcpa_prepared_pk **ppk: array of 4 pointers to
+*                                                prepared public keys
+*              - const indcpa_fwd *fwd: pointer to (secret) information forwarded
+*                                       from indcpa_enc_c1_fwd
+*              - const uint8_t coins2: 4 arrays of public-key dependent coins
+**************************************************/
+void indcpa_enc_c2_prepared_4x(uint8_t *const c2[4],
+                               const uint8_t msg[KYBER_INDCPA_MSGBYTES],
+                               const indcpa_prepared_pk *const ppk[4],
+                               const indcpa_fwd *fwd,
+                               const uint8_t coins2[4][KYBER_SYMBYTES])
+{
+  unsigned int j;
+  polyvec pkpv0[4], pkpv1[4];
+  poly k, epp0[4], epp1[4];
+  uint8_t flippks[4];
+  PROFILE_START(t);
+
+  getnoise_c2_4x(epp0, epp1, flippks, coins2);
+  PROFILE_LAP(t, MKEM_PROFILE_NOISE);
+
+  poly_frommsg(&k, msg);
+
+  for(j=0;j<4;j++) {
+    pkpv0[j] = ppk[j]->pkpv0;
+    pkpv1[j] = ppk[j]->pkpv1;
+  }
+  enc_c2_4x(c2, &k, pkpv0, pkpv1, fwd, epp0, epp1, flippks);
 }
 
+/*************************************************
+* Name:        indcpa_enc_c2_samepk_4x
+*
+* Description: Four-way variant of indcpa_enc_c2_prepared for one public
+*              key and four different messages with their own forwarded
+*              information, as needed for re-encryption of a batch of
+*              ciphertexts during decapsulation
+*
+* Arguments:   - uint8_t **c2: array of 4 pointers to output ciphertext components
+*                              (each of length MKYBER_C2BYTES bytes)
+*              - const uint8_t **m: array of 4 pointers to input plaintexts
+*                                   (each of length KYBER_INDCPA_MSGBYTES bytes)
+*              - const indcpa_prepared_pk *ppk: pointer to prepared public key
+*              - const indcpa_fwd **fwd: array of 4 pointers to (secret) information
+*                                        forwarded from indcpa_enc_c1_fwd
+*              - const uint8_t coins2: 4 arrays of public-key dependent coins
+**************************************************/
+void indcpa_enc_c2_samepk_4x(uint8_t *const c2[4],
+                             const uint8_t *const msg[4],
+                             const indcpa_prepared_pk *ppk,
+                             const indcpa_fwd *const fwd[4],
+                             const uint8_t coins2[4][KYBER_SYMBYTES])
+{
+  unsigned int j;
+  polyvec pkpv0, pkpv1;
+  poly k, epp0[4], epp1[4];
+  uint8_t flippks[4];
+  PROFILE_START(t);
+
+  getnoise_c2_4x(epp0, epp1, flippks, coins2);
+  PROFILE_LAP(t, MKEM_PROFILE_NOISE);
+
+  for(j=0;j<4;j++) {
+    poly_frommsg(&k, msg[j]);
+    pkpv0 = ppk->pkpv0;
+    pkpv1 = ppk->pkpv1;
+    enc_c2(c2[j], &k, &pkpv0, &pkpv1, fwd[j], &epp0[j], &epp1[j], flippks[j]);
+  }
+}
+
+/*************************************************
+* Name:        indcpa_prepare_sk
+*
+* Description: Unpacks a secret key once for repeated use with
+*              indcpa_dec_prepared
+*
+* Arguments:   - indcpa_prepared_sk *psk: pointer to output prepared secret key
+*              - const uint8_t *sk: pointer to input secret key
+*                                   (of length MKYBER_INDCPA_SECRETKEYBYTES)
+**************************************************/
+void indcpa_prepare_sk(indcpa_prepared_sk *psk,
+                       const uint8_t sk[MKYBER_INDCPA_SECRETKEYBYTES])
+{
+  unpack_sk(&psk->skpv, &psk->flip, sk);
+}
 
 /*************************************************
 * Name:        indcpa_dec
@@ -277,29 +895,58 @@ void indcpa_dec(uint8_t m[KYBER_INDCPA_MSGBYTES],
                 const uint8_t c2[MKYBER_C2BYTES],
                 const uint8_t sk[MKYBER_INDCPA_SECRETKEYBYTES])
 {
-  polyvec b0, b1, skpv;
+  indcpa_prepared_sk psk;
+
+  indcpa_prepare_sk(&psk, sk);
+  indcpa_dec_prepared(m, c1, c2, &psk);
+}
+
+/*************************************************
+* Name:        indcpa_dec_prepared
+*
+* Description: Same as indcpa_dec, but for a secret key that was
+*              unpacked beforehand by indcpa_prepare_sk
+*
+* Arguments:   - uint8_t *m: pointer to output decrypted message
+*                            (of length KYBER_INDCPA_MSGBYTES)
+*              - const uint8_t *c1: pointer to input first ciphertext component
+*                                   (of length MKYBER_C1BYTES)
+*              - const uint8_t *c2: pointer to input second ciphertext component
+*                                   (of length MKYBER_C2BYTES)
+*              - const indcpa_prepared_sk *psk: pointer to prepared secret key
+**************************************************/
+void indcpa_dec_prepared(uint8_t m[KYBER_INDCPA_MSGBYTES],
+                         const uint8_t c1[MKYBER_C1BYTES],
+                         const uint8_t c2[MKYBER_C2BYTES],
+                         const indcpa_prepared_sk *psk)
+{
+  polyvec b0, b1;
   poly v0, v1, mp;
-  uint8_t bb;
 
   uint8_t tbuf[MKYBER_C1BYTES+12];
+  PROFILE_START(t);
   memcpy(tbuf,c1+KYBER_POLYVECCOMPRESSEDBYTES,KYBER_POLYVECCOMPRESSEDBYTES);
 
   polyvec_decompress(&b0, c1);
   polyvec_decompress(&b1, tbuf);
-  polyvec_cmov(&b0, &b1, sk[MKYBER_INDCPA_SECRETKEYBYTES-1]^c2[MKYBER_C2BYTES-1]);
+  polyvec_cmov(&b0, &b1, psk->flip^c2[MKYBER_C2BYTES-1]);
 
   poly_decompress(&v0, c2);
   poly_decompress(&v1, c2+KYBER_POLYCOMPRESSEDBYTES);
 
-  unpack_sk(&skpv, &bb, sk);
-  poly_cmov(&v0, &v1, bb^c2[MKYBER_C2BYTES-1]);
+  poly_cmov(&v0, &v1, psk->flip^c2[MKYBER_C2BYTES-1]);
+  PROFILE_LAP(t, MKEM_PROFILE_COMPRESS);
 
   polyvec_ntt(&b0);
-  polyvec_basemul_acc_montgomery(&mp, &skpv, &b0);
+  PROFILE_LAP(t, MKEM_PROFILE_NTT);
+  polyvec_basemul_acc_montgomery(&mp, &psk->skpv, &b0);
+  PROFILE_LAP(t, MKEM_PROFILE_BASEMUL);
   poly_invntt_tomont(&mp);
+  PROFILE_LAP(t, MKEM_PROFILE_NTT);
 
   poly_sub(&mp, &v0, &mp);
   poly_reduce(&mp);
 
   poly_tomsg(m, &mp);
+  PROFILE_LAP(t, MKEM_PROFILE_COMPRESS);
 }
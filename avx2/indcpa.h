@@ -5,6 +5,33 @@
 #include "params.h"
 #include "polyvec.h"
 
+/* Public key unpacked into NTT domain, see indcpa_prepare_pk */
+typedef struct {
+  polyvec pkpv0;
+  polyvec pkpv1;
+} indcpa_prepared_pk;
+
+/* Secret key unpacked into NTT domain, see indcpa_prepare_sk */
+typedef struct {
+  polyvec skpv;
+  uint8_t flip;
+} indcpa_prepared_sk;
+
+/* Forwarded noise vectors sp0, sp1 in NTT domain, see indcpa_enc_c1_fwd;
+ * spp0, spp1 are the same vectors prepared as basemul operands */
+typedef struct {
+  polyvec sp0;
+  polyvec sp1;
+  polyvec_prepared spp0;
+  polyvec_prepared spp1;
+} indcpa_fwd;
+
+/* Expanded matrix A^T for a public seed, see indcpa_seedctx_init */
+typedef struct {
+  polyvec at[KYBER_K];
+  uint8_t seed[KYBER_SYMBYTES];
+} indcpa_seedctx;
+
 #define gen_matrix KYBER_NAMESPACE(gen_matrix)
 void gen_matrix(polyvec *a, const uint8_t seed[KYBER_SYMBYTES], int transposed);
 
@@ -12,17 +39,81 @@ void indcpa_mkeypair(uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
                      uint8_t sk[MKYBER_INDCPA_SECRETKEYBYTES],
                      const uint8_t publicseed[KYBER_SYMBYTES]);
 
+void indcpa_mkeypair_4x(uint8_t *const pk[4],
+                        uint8_t *const sk[4],
+                        const polyvec a[KYBER_K],
+                        const uint8_t *const coins[4]);
+
+void indcpa_seedctx_init(indcpa_seedctx *ctx,
+                         const uint8_t seed[KYBER_SYMBYTES]);
+
 void indcpa_enc_c1(uint8_t c1[MKYBER_C1BYTES],
                    uint8_t fwd[MKYBER_FWDBYTES],
                    const uint8_t seed[KYBER_SYMBYTES],
                    const uint8_t coins[KYBER_SYMBYTES]);
 
+void indcpa_enc_c1_ctx(uint8_t c1[MKYBER_C1BYTES],
+                       uint8_t fwd[MKYBER_FWDBYTES],
+                       const indcpa_seedctx *ctx,
+                       const uint8_t coins[KYBER_SYMBYTES]);
+
+void indcpa_enc_c1_fwd(uint8_t c1[MKYBER_C1BYTES],
+                       indcpa_fwd *fwd,
+                       const indcpa_seedctx *ctx,
+                       const uint8_t coins[KYBER_SYMBYTES]);
+
+void indcpa_fwd_tobytes(uint8_t r[MKYBER_FWDBYTES], const indcpa_fwd *fwd);
+void indcpa_fwd_frombytes(indcpa_fwd *fwd, const uint8_t a[MKYBER_FWDBYTES]);
+
 void indcpa_enc_c2(uint8_t c2[MKYBER_C2BYTES],
                    const uint8_t m[KYBER_INDCPA_MSGBYTES],
                    const uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
                    const uint8_t fwd[MKYBER_FWDBYTES],
                    const uint8_t coins2[KYBER_SYMBYTES]);
 
+void indcpa_enc_c2_fwd(uint8_t c2[MKYBER_C2BYTES],
+                       const uint8_t m[KYBER_INDCPA_MSGBYTES],
+                       const uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES],
+                       const indcpa_fwd *fwd,
+                       const uint8_t coins2[KYBER_SYMBYTES]);
+
+void indcpa_enc_c2_4x(uint8_t *const c2[4],
+                      const uint8_t m[KYBER_INDCPA_MSGBYTES],
+                      const uint8_t *const pk[4],
+                      const indcpa_fwd *fwd,
+                      const uint8_t coins2[4][KYBER_SYMBYTES]);
+
+void indcpa_prepare_pk(indcpa_prepared_pk *ppk,
+                       const uint8_t pk[MKYBER_INDCPA_PUBLICKEYBYTES]);
+
+int indcpa_check_prepared_pk(const indcpa_prepared_pk *ppk);
+
+void indcpa_enc_c2_prepared(uint8_t c2[MKYBER_C2BYTES],
+                            const uint8_t m[KYBER_INDCPA_MSGBYTES],
+                            const indcpa_prepared_pk *ppk,
+                            const indcpa_fwd *fwd,
+                            const uint8_t coins2[KYBER_SYMBYTES]);
+
+void indcpa_enc_c2_prepared_4x(uint8_t *const c2[4],
+                               const uint8_t m[KYBER_INDCPA_MSGBYTES],
+                               const indcpa_prepared_pk *const ppk[4],
+                               const indcpa_fwd *fwd,
+                               const uint8_t coins2[4][KYBER_SYMBYTES]);
+
+void indcpa_enc_c2_samepk_4x(uint8_t *const c2[4],
+                             const uint8_t *const m[4],
+                             const indcpa_prepared_pk *ppk,
+                             const indcpa_fwd *const fwd[4],
+                             const uint8_t coins2[4][KYBER_SYMBYTES]);
+
+void indcpa_prepare_sk(indcpa_prepared_sk *psk,
+                       const uint8_t sk[MKYBER_INDCPA_SECRETKEYBYTES]);
+
+void indcpa_dec_prepared(uint8_t m[KYBER_INDCPA_MSGBYTES],
+                         const uint8_t c1[MKYBER_C1BYTES],
+                         const uint8_t c2[MKYBER_C2BYTES],
+                         const indcpa_prepared_sk *psk);
+
 void indcpa_dec(uint8_t m[KYBER_INDCPA_MSGBYTES],
                 const uint8_t c1[MKYBER_C1BYTES],
                 const uint8_t c2[MKYBER_C2BYTES],
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "params.h"
+#include "consts.h"
+#include "fips202.h"
+#include "fips202x4.h"
+#include "ntt.h"
+#include "poly.h"
+#include "polyvec.h"
+#include "uniform.h"
+#include "verify.h"
+#include "perfcounters.h"
+#include "randombytes.h"
+
+/* Cycles per call of the primitives used by crypto_mkem_enc and
+ * crypto_mkem_dec, see the README */
+
+#define NRUNS 1000
+#define NWARMUP 100
+#define CALIBLOOP (1 << 20)
+#define CALIBRUNS 5
+/* Largest tolerated drift of the clock ratio across one measurement, in percent */
+#define MAXDRIFT 2
+
+static inline uint64_t cpucycles(void) {
+  uint64_t result;
+
+  __asm__ volatile ("rdtsc; shlq $32,%%rdx; orq %%rdx,%%rax"
+    : "=a" (result) : : "%rdx");
+
+  return result;
+}
+
+static uint64_t cpucycles_overhead(void) {
+  uint64_t t0, t1, overhead = -1LL;
+  unsigned int i;
+
+  for(i=0;i<100000;i++) {
+    t0 = cpucycles();
+    __asm__ volatile ("");
+    t1 = cpucycles();
+    if(t1 - t0 < overhead)
+      overhead = t1 - t0;
+  }
+
+  return overhead;
+}
+
+/*************************************************
+* Name:        tsc_per_cycle
+*
+* Description: Estimates the ratio of time stamp counter ticks to core
+*              clock cycles by timing a loop that takes one core cycle
+*              per iteration (a fused decrement and branch)
+*
+* Returns the smallest ratio of CALIBRUNS runs
+**************************************************/
+static double tsc_per_cycle(void) {
+  uint64_t t0, t1, best = -1LL;
+  uint64_t n;
+  unsigned int i;
+
+  for(i=0;i<CALIBRUNS;i++) {
+    n = CALIBLOOP;
+    t0 = cpucycles();
+    __asm__ volatile ("1: dec %0; jnz 1b" : "+r" (n));
+    t1 = cpucycles();
+    if(t1 - t0 < best)
+      best = t1 - t0;
+  }
+
+  return (double)best/CALIBLOOP;
+}
+
+static int cmp_uint64(const void *a, const void *b) {
+  if(*(uint64_t *)a < *(uint64_t *)b) return -1;
+  if(*(uint64_t *)a > *(uint64_t *)b) return 1;
+  return 0;
+}
+
+static uint64_t median(uint64_t *l, size_t llen) {
+  qsort(l,llen,sizeof(uint64_t),cmp_uint64);
+
+  if(llen%2) return l[llen/2];
+  else return (l[llen/2-1]+l[llen/2])/2;
+}
+
+static perfcounters pc;
+static int have_perf;
+
+/* Prints the averages per call of the hardware events counted over
+ * all runs, n/a for those that are unavailable */
+static void print_perf(const uint64_t val[PERF_NEVENTS])
+{
+  int i;
+
+  if(pc.fd[PERF_INSTRUCTIONS] != -1 && val[PERF_CYCLES])
+    printf(" %6.2f", (double)val[PERF_INSTRUCTIONS]/val[PERF_CYCLES]);
+  else
+    printf(" %6s", "n/a");
+  for(i=PERF_INSTRUCTIONS;i<PERF_NEVENTS;i++) {
+    if(i == PERF_RAW && pc.fd[PERF_RAW] == -1)
+      continue;
+    if(pc.fd[i] != -1)
+      printf(" %10.1f", (double)val[i]/NRUNS);
+    else
+      printf(" %10s", "n/a");
+  }
+}
+
+/* Prints the median cycles of one call and the bytes processed per
+ * cycle, followed by the hardware events if available; the measurement
+ * is flagged if the clock ratio before and after it differs by more
+ * than MAXDRIFT percent */
+static void print_micro(const char *s, size_t bytes, uint64_t *t, double ratio0,
+                        const uint64_t val[PERF_NEVENTS])
+{
+  static uint64_t overhead = -1;
+  uint64_t med;
+  double drift;
+  size_t i;
+
+  if(overhead == (uint64_t)-1)
+    overhead = cpucycles_overhead();
+
+  drift = 100*(tsc_per_cycle()/ratio0 - 1);
+  for(i=0;i<NRUNS;++i)
+    t[i] = t[i+1] - t[i] - overhead;
+  med = median(t, NRUNS);
+
+  printf("%-36s %10lu %10lu %10.3f", s, bytes, med, med ? (double)bytes/med : 0.0);
+  if(have_perf)
+    print_perf(val);
+  if(drift > MAXDRIFT || drift < -MAXDRIFT)
+    printf("  unstable (clock ratio %+.1f%%)", drift);
+  printf("\n");
+}
+
+#define MICROBENCH(NAME, BYTES, CALL) \
+  do { \
+    for(i=0;i<NWARMUP;i++) { \
+      CALL; \
+    } \
+    ratio = tsc_per_cycle(); \
+    perfcounters_start(&pc); \
+    for(i=0;i<NRUNS;i++) { \
+      t[i] = cpucycles(); \
+      CALL; \
+    } \
+    t[NRUNS] = cpucycles(); \
+    perfcounters_stop(&pc, val); \
+    print_micro(NAME, BYTES, t, ratio, val); \
+  } while(0)
+
+static uint64_t t[NRUNS+1];
+
+int main(void)
+{
+  unsigned int i;
+  int j;
+  double ratio;
+  uint64_t val[PERF_NEVENTS];
+
+  uint8_t seed[KYBER_SYMBYTES];
+  uint8_t pk[MKYBER_PUBLICKEYBYTES];
+  uint8_t buf[KYBER_POLYVECCOMPRESSEDBYTES+12];
+  uint8_t c2a[MKYBER_C2BYTES], c2b[MKYBER_C2BYTES];
+  uint8_t out[4][3*SHAKE128_RATE];
+  uint8_t in[4][KYBER_SYMBYTES+2];
+  uint8_t h[32];
+  polyvec matrix[KYBER_K];
+  polyvec a, b;
+  poly p[4];
+
+  randombytes(seed, sizeof(seed));
+  randombytes(pk, sizeof(pk));
+  randombytes(c2a, sizeof(c2a));
+  memcpy(c2b, c2a, sizeof(c2b));
+  randombytes((uint8_t *)in, sizeof(in));
+  gen_polyvec(&a, seed);
+  seed[0] ^= 1;
+  gen_polyvec(&b, seed);
+  p[0] = a.vec[0];
+
+  have_perf = perfcounters_open(&pc) > 0;
+
+  ratio = tsc_per_cycle();
+  printf("KYBER_K=%d, %.3f TSC ticks per core cycle", KYBER_K, ratio);
+  if(ratio < 0.95 || ratio > 1.05)
+    printf(" (cycles below are TSC ticks)");
+  printf("\n\n%-36s %10s %10s %10s", "primitive", "bytes", "cycles", "bytes/cyc");
+  if(have_perf) {
+    printf(" %6s", "ipc");
+    for(j=PERF_INSTRUCTIONS;j<PERF_NEVENTS;j++)
+      if(j != PERF_RAW || pc.fd[PERF_RAW] != -1)
+        printf(" %10s", perfcounters_names[j]);
+  }
+  printf("\n");
+
+  MICROBENCH("gen_matrix", sizeof(matrix), gen_matrix(matrix, seed, 0));
+  MICROBENCH("gen_polyvec", sizeof(polyvec), gen_polyvec(&a, seed));
+  MICROBENCH("poly_getnoise_eta1_4x", 4*sizeof(poly),
+             poly_getnoise_eta1_4x(&p[0], &p[1], &p[2], &p[3], seed, 0, 1, 2, 3));
+  MICROBENCH("poly_getnoise_eta2", sizeof(poly), poly_getnoise_eta2(&p[0], seed, 0));
+  MICROBENCH("ntt_avx", sizeof(poly), ntt_avx(p[0].vec, qdata.vec));
+  MICROBENCH("invntt_avx", sizeof(poly), invntt_avx(p[0].vec, qdata.vec));
+  MICROBENCH("polyvec_basemul_acc_montgomery", 2*sizeof(polyvec),
+             polyvec_basemul_acc_montgomery(&p[1], &a, &b));
+  MICROBENCH("polyvec_compress", KYBER_POLYVECCOMPRESSEDBYTES, polyvec_compress(buf, &a));
+  MICROBENCH("polyvec_decompress", KYBER_POLYVECCOMPRESSEDBYTES, polyvec_decompress(&b, buf));
+  MICROBENCH("poly_compress", KYBER_POLYCOMPRESSEDBYTES, poly_compress(buf, &p[1]));
+  MICROBENCH("shake128x4", 4*sizeof(out[0]),
+             shake128x4(out[0], out[1], out[2], out[3], sizeof(out[0]),
+                        in[0], in[1], in[2], in[3], sizeof(in[0])));
+  MICROBENCH("shake256x4", 4*KYBER_ETA1*KYBER_N/4,
+             shake256x4(out[0], out[1], out[2], out[3], KYBER_ETA1*KYBER_N/4,
+                        in[0], in[1], in[2], in[3], KYBER_SYMBYTES+1));
+  MICROBENCH("sha3_256 (public key)", MKYBER_PUBLICKEYBYTES, sha3_256(h, pk, sizeof(pk)));
+  MICROBENCH("verify (c2)", MKYBER_C2BYTES, verify(c2a, c2b, MKYBER_C2BYTES));
+  MICROBENCH("cmov (c2)", MKYBER_C2BYTES, cmov(c2a, c2b, MKYBER_C2BYTES, h[0] & 1));
+
+  perfcounters_close(&pc);
+  return 0;
+}
@@ -0,0 +1,774 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mkem.h"
+#include "mkem_pool.h"
+#include "randombytes.h"
+#include "perfcounters.h"
+
+/* Benchmark driver with command-line options and machine-readable
+ * output; see usage() and the README */
+
+#define IMPL "avx2"
+#define MAXCOUNTS 32
+#define MAXCPUS 1024
+
+#define PIN_NONE 0
+#define PIN_COMPACT 1
+#define PIN_SPREAD 2
+
+#if KYBER_K == 2
+#define PARAMSET 512
+#elif KYBER_K == 3
+#define PARAMSET 768
+#elif KYBER_K == 4
+#define PARAMSET 1024
+#endif
+
+typedef struct {
+  size_t counts[MAXCOUNTS];
+  size_t ncounts;
+  size_t iters;
+  unsigned int threads;
+  int csv;
+  int events;
+  int scale;
+  size_t concurrency[MAXCOUNTS];
+  size_t nconcurrency;
+  size_t decbatch;
+  int pin;
+} bench_opts;
+
+typedef struct {
+  uint64_t min, median, p90, p99, max;
+} bench_stats;
+
+/* Stays closed unless -e is given */
+static perfcounters pc = {{-1, -1, -1, -1, -1, -1}, -1, {0}};
+
+static inline uint64_t cpucycles(void) {
+  uint64_t result;
+
+  __asm__ volatile ("rdtsc; shlq $32,%%rdx; orq %%rdx,%%rax"
+    : "=a" (result) : : "%rdx");
+
+  return result;
+}
+
+static uint64_t nanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int cmp_uint64(const void *a, const void *b) {
+  if(*(uint64_t *)a < *(uint64_t *)b) return -1;
+  if(*(uint64_t *)a > *(uint64_t *)b) return 1;
+  return 0;
+}
+
+/* Nearest-rank percentile of a sorted list */
+static uint64_t percentile(const uint64_t *l, size_t llen, unsigned int p) {
+  size_t rank = (p*llen + 99)/100;
+
+  return l[rank ? rank-1 : 0];
+}
+
+static void compute_stats(bench_stats *s, uint64_t *l, size_t llen) {
+  qsort(l, llen, sizeof(uint64_t), cmp_uint64);
+
+  s->min = l[0];
+  s->median = (llen%2) ? l[llen/2] : (l[llen/2-1]+l[llen/2])/2;
+  s->p90 = percentile(l, llen, 90);
+  s->p99 = percentile(l, llen, 99);
+  s->max = l[llen-1];
+}
+
+static void print_header(const bench_opts *o) {
+  int i;
+
+  if(o->csv && o->scale) {
+    printf("impl,param,op,recipients,concurrency,iterations,ops_per_sec,"
+           "cycles_min,cycles_median,cycles_p90,cycles_p99,cycles_max,"
+           "ns_min,ns_median,ns_p90,ns_p99,ns_max\n");
+  }
+  else if(o->csv) {
+    printf("impl,param,op,recipients,threads,iterations,"
+           "cycles_min,cycles_median,cycles_p90,cycles_p99,cycles_max,"
+           "ns_min,ns_median,ns_p90,ns_p99,ns_max");
+    if(o->events) {
+      for(i=0;i<PERF_NEVENTS;i++)
+        printf(",pmu_%s", perfcounters_names[i]);
+      printf(",ipc");
+    }
+    printf("\n");
+  }
+  else
+    printf("[");
+}
+
+/* Prints the averages per iteration of the hardware events; fields of
+ * unavailable events are empty (CSV) or null (JSON) */
+static void print_events(const bench_opts *o, const uint64_t val[PERF_NEVENTS]) {
+  int i;
+  int have_ipc = pc.fd[PERF_CYCLES] != -1 && pc.fd[PERF_INSTRUCTIONS] != -1 && val[PERF_CYCLES];
+
+  if(!o->csv)
+    printf(",\n   \"pmu\": {");
+  for(i=0;i<PERF_NEVENTS;i++) {
+    if(o->csv)
+      printf(",");
+    else
+      printf("%s\"%s\": ", i ? ", " : "", perfcounters_names[i]);
+    if(pc.fd[i] != -1)
+      printf("%.1f", (double)val[i]/o->iters);
+    else if(!o->csv)
+      printf("null");
+  }
+  if(o->csv)
+    printf(",");
+  else
+    printf(", \"ipc\": ");
+  if(have_ipc)
+    printf("%.3f", (double)val[PERF_INSTRUCTIONS]/val[PERF_CYCLES]);
+  else if(!o->csv)
+    printf("null");
+  if(!o->csv)
+    printf("}");
+}
+
+static void print_footer(const bench_opts *o) {
+  if(!o->csv)
+    printf("\n]\n");
+}
+
+static void print_result(const bench_opts *o, const char *op, size_t recipients, unsigned int threads,
+                         const bench_stats *cyc, const bench_stats *ns,
+                         const uint64_t val[PERF_NEVENTS]) {
+  static int first = 1;
+
+  if(o->csv) {
+    printf("%s,%d,%s,%lu,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+           IMPL, PARAMSET, op, recipients, threads, o->iters,
+           cyc->min, cyc->median, cyc->p90, cyc->p99, cyc->max,
+           ns->min, ns->median, ns->p90, ns->p99, ns->max);
+  }
+  else {
+    printf("%s\n  {\"impl\": \"%s\", \"param\": %d, \"op\": \"%s\", \"recipients\": %lu, "
+           "\"threads\": %u, \"iterations\": %lu,\n"
+           "   \"cycles\": {\"min\": %lu, \"median\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu},\n"
+           "   \"ns\": {\"min\": %lu, \"median\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}",
+           first ? "" : ",", IMPL, PARAMSET, op, recipients, threads, o->iters,
+           cyc->min, cyc->median, cyc->p90, cyc->p99, cyc->max,
+           ns->min, ns->median, ns->p90, ns->p99, ns->max);
+  }
+  if(o->events)
+    print_events(o, val);
+  printf(o->csv ? "\n" : "}");
+  first = 0;
+  fflush(stdout);
+}
+
+static void print_scale(const bench_opts *o, const char *op, size_t recipients,
+                        size_t concurrency, double ops_per_sec,
+                        const bench_stats *cyc, const bench_stats *ns) {
+  static int first = 1;
+
+  if(o->csv) {
+    printf("%s,%d,%s,%lu,%lu,%lu,%.1f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+           IMPL, PARAMSET, op, recipients, concurrency, o->iters, ops_per_sec,
+           cyc->min, cyc->median, cyc->p90, cyc->p99, cyc->max,
+           ns->min, ns->median, ns->p90, ns->p99, ns->max);
+  }
+  else {
+    printf("%s\n  {\"impl\": \"%s\", \"param\": %d, \"op\": \"%s\", \"recipients\": %lu, "
+           "\"concurrency\": %lu, \"iterations\": %lu, \"ops_per_sec\": %.1f,\n"
+           "   \"cycles\": {\"min\": %lu, \"median\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu},\n"
+           "   \"ns\": {\"min\": %lu, \"median\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}}",
+           first ? "" : ",", IMPL, PARAMSET, op, recipients, concurrency, o->iters, ops_per_sec,
+           cyc->min, cyc->median, cyc->p90, cyc->p99, cyc->max,
+           ns->min, ns->median, ns->p90, ns->p99, ns->max);
+  }
+  first = 0;
+  fflush(stdout);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-p 512|768|1024] [-n counts] [-i iterations] [-t threads] [-f json|csv] [-e]\n"
+          "       %s -s [-c concurrency] [-b batch] [-a none|compact|spread] [-p ...] [-n ...] [-i ...] [-f ...]\n"
+          "  -p  parameter set (runs the binary built for it)\n"
+          "  -n  comma-separated recipient counts for encapsulation (default 1,2,10,100,1000)\n"
+          "  -i  iterations per measurement (default 1000)\n"
+          "  -t  worker threads for encapsulation (default 1, no pool)\n"
+          "  -f  output format (default json)\n"
+          "  -e  also report hardware event counts per operation (perf_event_open)\n"
+          "  -s  scaling mode: independent operations in concurrent threads\n"
+          "  -c  comma-separated thread counts for -s (default 1,2,4,... up to the CPU count)\n"
+          "  -b  ciphertexts per decapsulation batch for -s (default 1)\n"
+          "  -a  pinning of the threads of -s: none, compact (fill NUMA nodes one by one)\n"
+          "      or spread (round robin over NUMA nodes); default none\n", prog, prog);
+}
+
+/*************************************************
+* Name:        exec_paramset
+*
+* Description: Replaces the process by the same driver built for another
+*              parameter set; its path is argv[0] with the trailing digits
+*              replaced by the parameter set
+**************************************************/
+static void exec_paramset(char **argv, const char *param) {
+  char path[4096];
+  size_t len = strlen(argv[0]);
+
+  while(len > 0 && argv[0][len-1] >= '0' && argv[0][len-1] <= '9')
+    len--;
+  if(len+strlen(param)+1 > sizeof(path)) {
+    fprintf(stderr, "ERROR: path too long\n");
+    exit(1);
+  }
+  memcpy(path, argv[0], len);
+  strcpy(path+len, param);
+
+  execv(path, argv);
+  fprintf(stderr, "ERROR: cannot execute %s: %s\n", path, strerror(errno));
+  exit(1);
+}
+
+static int parse_list(size_t list[MAXCOUNTS], size_t *n, char *arg) {
+  char *tok, *end;
+
+  *n = 0;
+  for(tok=strtok(arg, ",");tok!=NULL;tok=strtok(NULL, ",")) {
+    if(*n == MAXCOUNTS)
+      return -1;
+    list[*n] = strtoul(tok, &end, 10);
+    if(*end != '\0' || list[*n] == 0)
+      return -1;
+    (*n)++;
+  }
+  return *n ? 0 : -1;
+}
+
+static int parse_opts(bench_opts *o, int argc, char **argv) {
+  const size_t defaults[] = {1, 2, 10, 100, 1000};
+  char param[8];
+  char *end;
+  int c;
+
+  memcpy(o->counts, defaults, sizeof(defaults));
+  o->ncounts = sizeof(defaults)/sizeof(defaults[0]);
+  o->iters = 1000;
+  o->threads = 1;
+  o->csv = 0;
+  o->events = 0;
+  o->scale = 0;
+  o->nconcurrency = 0;
+  o->decbatch = 1;
+  o->pin = PIN_NONE;
+
+  while((c = getopt(argc, argv, "p:n:i:t:f:esc:b:a:h")) != -1) {
+    switch(c) {
+      case 'p':
+        if(strcmp(optarg, "512") && strcmp(optarg, "768") && strcmp(optarg, "1024"))
+          return -1;
+        sprintf(param, "%d", PARAMSET);
+        if(strcmp(optarg, param))
+          exec_paramset(argv, optarg);
+        break;
+      case 'n':
+        if(parse_list(o->counts, &o->ncounts, optarg))
+          return -1;
+        break;
+      case 'i':
+        o->iters = strtoul(optarg, &end, 10);
+        if(*end != '\0' || o->iters < 1)
+          return -1;
+        break;
+      case 't':
+        o->threads = strtoul(optarg, &end, 10);
+        if(*end != '\0' || o->threads < 1)
+          return -1;
+        break;
+      case 'f':
+        if(!strcmp(optarg, "csv"))
+          o->csv = 1;
+        else if(strcmp(optarg, "json"))
+          return -1;
+        break;
+      case 'e':
+        o->events = 1;
+        break;
+      case 's':
+        o->scale = 1;
+        break;
+      case 'c':
+        if(parse_list(o->concurrency, &o->nconcurrency, optarg))
+          return -1;
+        break;
+      case 'b':
+        o->decbatch = strtoul(optarg, &end, 10);
+        if(*end != '\0' || o->decbatch < 1)
+          return -1;
+        break;
+      case 'a':
+        if(!strcmp(optarg, "compact"))
+          o->pin = PIN_COMPACT;
+        else if(!strcmp(optarg, "spread"))
+          o->pin = PIN_SPREAD;
+        else if(strcmp(optarg, "none"))
+          return -1;
+        break;
+      default:
+        return -1;
+    }
+  }
+  /* Counters and the pool measure single operations */
+  if(o->scale && (o->events || o->threads > 1))
+    return -1;
+  return (optind == argc) ? 0 : -1;
+}
+
+/* Inputs shared read-only by the threads of the scaling mode */
+typedef struct {
+  const uint8_t *seed;
+  uint8_t *const *pk;
+  const uint8_t *c1;
+  const uint8_t *c2;
+  const uint8_t *sk;
+} scale_data;
+
+typedef struct {
+  pthread_t thread;
+  pthread_barrier_t *barrier;
+  const scale_data *d;
+  int dec;
+  size_t n;
+  size_t iters;
+  int cpu;
+  uint64_t *tc, *tn;
+  uint64_t start, end;
+  int err;
+} scale_worker;
+
+/*************************************************
+* Name:        dec_op
+*
+* Description: Decapsulates n ciphertexts under one secret key, as one
+*              operation of the scaling mode
+**************************************************/
+static void dec_op(uint8_t **ss, const uint8_t *const *c1s, const uint8_t *const *c2s,
+                   size_t n, const uint8_t *sk) {
+  if(n == 1)
+    crypto_mkem_dec(ss[0], c1s[0], c2s[0], sk);
+  else
+    crypto_mkem_dec_batch(ss, c1s, c2s, n, sk);
+}
+
+/*************************************************
+* Name:        scale_main
+*
+* Description: Thread of the scaling mode: pins itself, allocates (and so
+*              places) its output buffers, waits for the other threads and
+*              runs iters encapsulations to n recipients or decapsulations
+*              of n ciphertexts
+**************************************************/
+static void *scale_main(void *arg) {
+  scale_worker *w = arg;
+  const scale_data *d = w->d;
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t key[KYBER_SSBYTES];
+  uint8_t *buf, **out;
+  const uint8_t **c1s, **c2s;
+  uint64_t c0, n0;
+  cpu_set_t cpuset;
+  size_t i, bytes = w->dec ? KYBER_SSBYTES : MKYBER_C2BYTES;
+
+  if(w->cpu >= 0) {
+    CPU_ZERO(&cpuset);
+    CPU_SET(w->cpu, &cpuset);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset))
+      w->err = 1;
+  }
+
+  buf = malloc(w->n*bytes);
+  out = malloc(w->n*sizeof(uint8_t *));
+  c1s = malloc(w->n*sizeof(uint8_t *));
+  c2s = malloc(w->n*sizeof(uint8_t *));
+  if(!buf || !out || !c1s || !c2s)
+    w->err = 2;
+  else {
+    memset(buf, 0, w->n*bytes);
+    for(i=0;i<w->n;i++) {
+      out[i] = buf+i*bytes;
+      c1s[i] = d->c1;
+      c2s[i] = d->c2;
+    }
+  }
+
+  pthread_barrier_wait(w->barrier);
+  w->start = nanoseconds();
+  for(i=0;i<w->iters && w->err != 2;i++) {
+    c0 = cpucycles();
+    n0 = nanoseconds();
+    if(w->dec)
+      dec_op(out, c1s, c2s, w->n, d->sk);
+    else
+      crypto_mkem_enc(c1, out, key, d->seed, w->n, d->pk);
+    w->tn[i] = nanoseconds()-n0;
+    w->tc[i] = cpucycles()-c0;
+  }
+  w->end = nanoseconds();
+
+  free(buf);
+  free(out);
+  free(c1s);
+  free(c2s);
+  return NULL;
+}
+
+/*************************************************
+* Name:        parse_cpulist
+*
+* Description: Appends the CPUs of a list like "0-3,8" that are also in
+*              allowed to cpus
+*
+* Returns new number of CPUs in cpus
+**************************************************/
+static size_t parse_cpulist(int *cpus, size_t ncpus, const char *list, const cpu_set_t *allowed) {
+  char *end;
+  long lo, hi;
+
+  while(*list) {
+    lo = strtol(list, &end, 10);
+    if(end == list)
+      break;
+    hi = lo;
+    if(*end == '-')
+      hi = strtol(end+1, &end, 10);
+    for(;lo<=hi && ncpus<MAXCPUS;lo++)
+      if(lo < CPU_SETSIZE && CPU_ISSET(lo, allowed))
+        cpus[ncpus++] = lo;
+    list = (*end == ',') ? end+1 : end+strlen(end);
+  }
+  return ncpus;
+}
+
+/*************************************************
+* Name:        pin_order
+*
+* Description: Orders the CPUs this process may run on for pinning thread i
+*              to order[i]: compact fills one NUMA node after the other,
+*              spread takes one CPU of every node in turn. Nodes are read
+*              from /sys/devices/system/node; without it, all CPUs form
+*              one node.
+*
+* Returns number of CPUs in order (0 on error)
+**************************************************/
+static size_t pin_order(int *order, int pin) {
+  cpu_set_t allowed;
+  int cpus[MAXCPUS];
+  size_t first[MAXCPUS+1];
+  size_t ncpus = 0, nnodes = 0, n, k, r;
+  char path[64], list[4096];
+  FILE *f;
+  int node;
+
+  if(sched_getaffinity(0, sizeof(allowed), &allowed))
+    return 0;
+
+  for(node=0;node<MAXCPUS;node++) {
+    sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+    f = fopen(path, "r");
+    if(f == NULL)
+      continue;
+    if(fgets(list, sizeof(list), f) != NULL) {
+      list[strcspn(list, "\n")] = '\0';
+      first[nnodes] = ncpus;
+      ncpus = parse_cpulist(cpus, ncpus, list, &allowed);
+      if(ncpus > first[nnodes])
+        nnodes++;
+    }
+    fclose(f);
+  }
+  if(nnodes == 0) {
+    for(k=0;k<CPU_SETSIZE && ncpus<MAXCPUS;k++)
+      if(CPU_ISSET(k, &allowed))
+        cpus[ncpus++] = k;
+    first[nnodes++] = 0;
+  }
+  first[nnodes] = ncpus;
+
+  if(pin != PIN_SPREAD) {
+    memcpy(order, cpus, ncpus*sizeof(int));
+    return ncpus;
+  }
+
+  n = 0;
+  for(r=0;n<ncpus;r++)
+    for(k=0;k<nnodes;k++)
+      if(first[k]+r < first[k+1])
+        order[n++] = cpus[first[k]+r];
+  return n;
+}
+
+/*************************************************
+* Name:        run_scale
+*
+* Description: Runs one measurement of the scaling mode with nthreads
+*              threads and prints aggregate operations per second (over
+*              the time from the common start to the end of the last
+*              thread) and the latencies of the operations of all threads
+*
+* Returns 0 on success, -1 if threads could not be started
+**************************************************/
+static int run_scale(const bench_opts *o, const scale_data *d, int dec, size_t n,
+                     size_t nthreads, const int *order, size_t norder,
+                     uint64_t *tc, uint64_t *tn) {
+  pthread_barrier_t barrier;
+  scale_worker *w;
+  bench_stats cyc, ns;
+  uint64_t start = -1LL, end = 0;
+  size_t i, started;
+  int err = 0;
+
+  w = calloc(nthreads, sizeof(scale_worker));
+  if(w == NULL || pthread_barrier_init(&barrier, NULL, nthreads)) {
+    free(w);
+    return -1;
+  }
+
+  for(started=0;started<nthreads;started++) {
+    w[started].barrier = &barrier;
+    w[started].d = d;
+    w[started].dec = dec;
+    w[started].n = n;
+    w[started].iters = o->iters;
+    w[started].cpu = (o->pin != PIN_NONE && norder > 0) ? order[started % norder] : -1;
+    w[started].tc = tc+started*o->iters;
+    w[started].tn = tn+started*o->iters;
+    if(pthread_create(&w[started].thread, NULL, scale_main, &w[started]))
+      break;
+  }
+  if(started < nthreads) {
+    /* The barrier never opens, so fail without waiting for the others */
+    fprintf(stderr, "ERROR: cannot start %lu threads\n", nthreads);
+    exit(1);
+  }
+
+  for(i=0;i<nthreads;i++) {
+    pthread_join(w[i].thread, NULL);
+    if(w[i].start < start)
+      start = w[i].start;
+    if(w[i].end > end)
+      end = w[i].end;
+    err |= w[i].err;
+  }
+  pthread_barrier_destroy(&barrier);
+  free(w);
+
+  if(err & 2) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    return -1;
+  }
+  if(err & 1)
+    fprintf(stderr, "WARNING: cannot pin all threads, results are unpinned\n");
+
+  compute_stats(&cyc, tc, nthreads*o->iters);
+  compute_stats(&ns, tn, nthreads*o->iters);
+  print_scale(o, dec ? "dec" : "enc", n, nthreads,
+              (double)nthreads*o->iters*1000000000/(end-start), &cyc, &ns);
+  return 0;
+}
+
+/*************************************************
+* Name:        bench_scale
+*
+* Description: Scaling mode: measures independent encapsulations for every
+*              recipient count and decapsulations in batches of
+*              o->decbatch ciphertexts, each with every number of
+*              concurrent threads in o->concurrency (by default 1, 2, 4,
+*              ... up to the number of CPUs)
+*
+* Returns 0 on success, -1 on error
+**************************************************/
+static int bench_scale(bench_opts *o, const uint8_t *seed, uint8_t *const *pk,
+                       const uint8_t *c1, const uint8_t *c2, const uint8_t *sk) {
+  int order[MAXCPUS];
+  size_t norder, maxt, i, j;
+  uint64_t *tc, *tn;
+  scale_data d;
+  int ret = 0;
+
+  norder = pin_order(order, o->pin);
+  if(o->nconcurrency == 0) {
+    for(i=1;i<norder && o->nconcurrency<MAXCOUNTS-1;i*=2)
+      o->concurrency[o->nconcurrency++] = i;
+    o->concurrency[o->nconcurrency++] = norder ? norder : 1;
+  }
+
+  maxt = 1;
+  for(i=0;i<o->nconcurrency;i++)
+    if(o->concurrency[i] > maxt)
+      maxt = o->concurrency[i];
+  tc = malloc(maxt*o->iters*sizeof(uint64_t));
+  tn = malloc(maxt*o->iters*sizeof(uint64_t));
+  if(!tc || !tn) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    free(tc);
+    free(tn);
+    return -1;
+  }
+
+  d.seed = seed;
+  d.pk = pk;
+  d.c1 = c1;
+  d.c2 = c2;
+  d.sk = sk;
+
+  for(j=0;j<o->ncounts && !ret;j++)
+    for(i=0;i<o->nconcurrency && !ret;i++)
+      ret = run_scale(o, &d, 0, o->counts[j], o->concurrency[i], order, norder, tc, tn);
+  for(i=0;i<o->nconcurrency && !ret;i++)
+    ret = run_scale(o, &d, 1, o->decbatch, o->concurrency[i], order, norder, tc, tn);
+
+  free(tc);
+  free(tn);
+  return ret;
+}
+
+int main(int argc, char **argv)
+{
+  bench_opts o;
+  bench_stats cyc, ns;
+  uint64_t *tc, *tn;
+  uint64_t c0, n0;
+  uint64_t val[PERF_NEVENTS];
+
+  uint8_t seed[KYBER_SYMBYTES];
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t key[KYBER_SSBYTES];
+  uint8_t *pks, *sks, *c2buf;
+  uint8_t **pk, **c2s;
+  mkem_pool *pool = NULL;
+
+  size_t i, j, maxn;
+  int ret = 0;
+
+  if(parse_opts(&o, argc, argv)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  maxn = 1;
+  for(j=0;j<o.ncounts;j++)
+    if(o.counts[j] > maxn)
+      maxn = o.counts[j];
+
+  tc = malloc(o.iters*sizeof(uint64_t));
+  tn = malloc(o.iters*sizeof(uint64_t));
+  pks = malloc(maxn*MKYBER_PUBLICKEYBYTES);
+  sks = malloc(maxn*MKYBER_SECRETKEYBYTES);
+  c2buf = malloc(maxn*MKYBER_C2BYTES);
+  pk = malloc(maxn*sizeof(uint8_t *));
+  c2s = malloc(maxn*sizeof(uint8_t *));
+  if(!tc || !tn || !pks || !sks || !c2buf || !pk || !c2s) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    return 1;
+  }
+  for(i=0;i<maxn;i++) {
+    pk[i] = pks+i*MKYBER_PUBLICKEYBYTES;
+    c2s[i] = c2buf+i*MKYBER_C2BYTES;
+  }
+
+  if(o.threads > 1) {
+    pool = crypto_mkem_pool_new(o.threads, NULL);
+    if(pool == NULL) {
+      fprintf(stderr, "ERROR: cannot start %u threads\n", o.threads);
+      return 1;
+    }
+  }
+
+  if(o.events)
+    perfcounters_open(&pc);
+
+  randombytes(seed, KYBER_SYMBYTES);
+  print_header(&o);
+
+  if(o.scale) {
+    for(i=0;i<maxn;i++)
+      crypto_mkem_keypair(pks+i*MKYBER_PUBLICKEYBYTES, sks+i*MKYBER_SECRETKEYBYTES, seed);
+    /* Ciphertext decapsulated by the threads of the dec measurements */
+    crypto_mkem_enc(c1, c2s, key, seed, 1, pk);
+    ret = bench_scale(&o, seed, pk, c1, c2s[0], sks);
+  }
+  else {
+    perfcounters_start(&pc);
+    for(i=0;i<o.iters;i++) {
+      c0 = cpucycles();
+      n0 = nanoseconds();
+      crypto_mkem_keypair(pks, sks, seed);
+      tn[i] = nanoseconds()-n0;
+      tc[i] = cpucycles()-c0;
+    }
+    perfcounters_stop(&pc, val);
+    compute_stats(&cyc, tc, o.iters);
+    compute_stats(&ns, tn, o.iters);
+    print_result(&o, "keypair", 0, 1, &cyc, &ns, val);
+
+    for(i=0;i<maxn;i++)
+      crypto_mkem_keypair(pks+i*MKYBER_PUBLICKEYBYTES, sks+i*MKYBER_SECRETKEYBYTES, seed);
+
+    for(j=0;j<o.ncounts;j++) {
+      perfcounters_start(&pc);
+      for(i=0;i<o.iters;i++) {
+        c0 = cpucycles();
+        n0 = nanoseconds();
+        if(pool != NULL)
+          crypto_mkem_enc_pool(c1, c2s, key, seed, o.counts[j], pk, pool);
+        else
+          crypto_mkem_enc(c1, c2s, key, seed, o.counts[j], pk);
+        tn[i] = nanoseconds()-n0;
+        tc[i] = cpucycles()-c0;
+      }
+      perfcounters_stop(&pc, val);
+      compute_stats(&cyc, tc, o.iters);
+      compute_stats(&ns, tn, o.iters);
+      print_result(&o, "enc", o.counts[j], o.threads, &cyc, &ns, val);
+    }
+
+    perfcounters_start(&pc);
+    for(i=0;i<o.iters;i++) {
+      c0 = cpucycles();
+      n0 = nanoseconds();
+      crypto_mkem_dec(key, c1, c2s[0], sks);
+      tn[i] = nanoseconds()-n0;
+      tc[i] = cpucycles()-c0;
+    }
+    perfcounters_stop(&pc, val);
+    compute_stats(&cyc, tc, o.iters);
+    compute_stats(&ns, tn, o.iters);
+    print_result(&o, "dec", 1, 1, &cyc, &ns, val);
+  }
+
+  print_footer(&o);
+
+  perfcounters_close(&pc);
+  crypto_mkem_pool_free(pool);
+  free(tc);
+  free(tn);
+  free(pks);
+  free(sks);
+  free(c2buf);
+  free(pk);
+  free(c2s);
+  return ret;
+}
@@ -5,10 +5,12 @@
 
 #include "params.h"
 #include "mkem.h"
+#include "mkem_internal.h"
 #include "indcpa.h"
 #include "verify.h"
 #include "symmetric.h"
 #include "randombytes.h"
+#include "profile.h"
 
 /*************************************************
 * Name:        crypto_mkem_keypair
@@ -46,6 +48,85 @@ int crypto_mkem_keypair(uint8_t *pk, uint8_t *sk, const uint8_t *seed)
   return 0;
 }
 
+/*************************************************
+* Name:        crypto_mkem_keypair_batch
+*
+* Description: Generates num_keys key pairs for the same public seed.
+*              The matrix is expanded once, all randomness is drawn with a
+*              single call to randombytes and the fake public keys are
+*              expanded four at a time. For the same output of randombytes
+*              the keys are identical to num_keys calls of crypto_mkem_keypair.
+*
+* Arguments:   - uint8_t *pks: pointer to output public keys
+*                (an already allocated array of num_keys*MKYBER_PUBLICKEYBYTES bytes)
+*              - uint8_t *sks: pointer to output private keys
+*                (an already allocated array of num_keys*MKYBER_SECRETKEYBYTES bytes)
+*              - size_t num_keys: number of key pairs
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_keypair_batch(uint8_t *pks,
+                              uint8_t *sks,
+                              size_t num_keys,
+                              const uint8_t *seed)
+{
+  polyvec a[KYBER_K];
+  uint8_t coins[4][MKYBER_KEYPAIRCOINBYTES];
+  uint8_t dummypk[4][MKYBER_INDCPA_PUBLICKEYBYTES];
+  uint8_t dummysk[4][MKYBER_INDCPA_SECRETKEYBYTES];
+  uint8_t *pkx4[4], *skx4[4];
+  const uint8_t *coinsx4[4] = {coins[0], coins[1], coins[2], coins[3]};
+  uint8_t *rnd, *sk;
+  size_t i, j, n;
+
+  if(num_keys == 0)
+    return 0;
+
+  /* The randomness of all keys is stored at the end of the secret key
+   * buffer. The coins of key i start at or after the secret key of key i,
+   * so writing keys in order never overwrites coins that are still needed;
+   * the coins of the current group are copied out before its keys are written. */
+  rnd = sks + num_keys*(MKYBER_SECRETKEYBYTES-MKYBER_KEYPAIRCOINBYTES);
+  randombytes(rnd, num_keys*MKYBER_KEYPAIRCOINBYTES);
+
+  gen_matrix(a, seed, 0);
+
+  for(i=0;i<num_keys;i+=4)
+  {
+    n = (num_keys-i < 4) ? num_keys-i : 4;
+
+    for(j=0;j<n;j++) {
+      memcpy(coins[j], rnd+(i+j)*MKYBER_KEYPAIRCOINBYTES, MKYBER_KEYPAIRCOINBYTES);
+      pkx4[j] = pks+(i+j)*MKYBER_PUBLICKEYBYTES;
+      skx4[j] = sks+(i+j)*MKYBER_SECRETKEYBYTES;
+    }
+    /* Missing lanes of the last group repeat its first key and are discarded */
+    for(;j<4;j++) {
+      memcpy(coins[j], coins[0], MKYBER_KEYPAIRCOINBYTES);
+      pkx4[j] = dummypk[j];
+      skx4[j] = dummysk[j];
+    }
+
+    indcpa_mkeypair_4x(pkx4, skx4, a, coinsx4);
+
+    for(j=0;j<n;j++) {
+      sk = skx4[j] + MKYBER_INDCPA_SECRETKEYBYTES;
+      /* Copy public key into secret key */
+      memcpy(sk, pkx4[j], MKYBER_INDCPA_PUBLICKEYBYTES);
+      sk += MKYBER_INDCPA_PUBLICKEYBYTES;
+      /* Copy seed into secret key */
+      memcpy(sk, seed, KYBER_SYMBYTES);
+      sk += KYBER_SYMBYTES;
+      /* Value z for pseudo-random output on reject (implicit rejection) */
+      memcpy(sk, coins[j]+MKYBER_INDCPA_KEYPAIRCOINBYTES, KYBER_SYMBYTES);
+    }
+  }
+
+  return 0;
+}
+
 /*************************************************
 * Name:        crypto_mkem_enc_c1
 *
@@ -69,6 +150,85 @@ int crypto_mkem_enc_c1(uint8_t *c1,
                        uint8_t *fwd,
                        const uint8_t *seed,
                        const uint8_t *r)
+{
+  mkem_seedctx ctx;
+
+  crypto_mkem_seedctx_init(&ctx, seed);
+  return crypto_mkem_enc_c1_ctx(c1, ss, fwd, &ctx, r);
+}
+
+/*************************************************
+* Name:        crypto_mkem_seedctx_init
+*
+* Description: Expands the public matrix for a seed once, so that it can
+*              be reused by crypto_mkem_enc_c1_ctx and crypto_mkem_dec_ctx
+*
+* Arguments:   - mkem_seedctx *ctx: pointer to output seed context
+*              - const uint8_t *seed: pointer to the input public seed
+*                (of length KYBER_SYMBYTES)
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_seedctx_init(mkem_seedctx *ctx, const uint8_t *seed)
+{
+  indcpa_seedctx_init(ctx, seed);
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_c1_ctx
+*
+* Description: Same as crypto_mkem_enc_c1, but uses the matrix
+*              from a seed context
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - uint8_t *fwd: pointer to output (secret) information forwarded to enc_c2
+*                (an already allocated array of MKYBER_FWDBYTES bytes)
+*              - const mkem_seedctx *ctx: pointer to input seed context
+*              - const uint8_t *r: pointer to input random coins;
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_c1_ctx(uint8_t *c1,
+                           uint8_t *ss,
+                           uint8_t *fwd,
+                           const mkem_seedctx *ctx,
+                           const uint8_t *r)
+{
+  mkem_fwd tfwd;
+
+  crypto_mkem_enc_c1_fwd(c1, ss, &tfwd, ctx, r);
+  indcpa_fwd_tobytes(fwd, &tfwd);
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_c1_fwd
+*
+* Description: Same as crypto_mkem_enc_c1_ctx, but outputs the forwarded
+*              information unserialized for use with crypto_mkem_enc_c2_fwd
+*              in the same process
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - mkem_fwd *fwd: pointer to output (secret) information forwarded to enc_c2
+*              - const mkem_seedctx *ctx: pointer to input seed context
+*              - const uint8_t *r: pointer to input random coins;
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_c1_fwd(uint8_t *c1,
+                           uint8_t *ss,
+                           mkem_fwd *fwd,
+                           const mkem_seedctx *ctx,
+                           const uint8_t *r)
 {
   uint8_t msg[KYBER_SYMBYTES];
   uint8_t coins[KYBER_SYMBYTES];
@@ -80,7 +240,7 @@ int crypto_mkem_enc_c1(uint8_t *c1,
   /* Compute shared key as KDF(msg) */
   kdf(ss, msg, KYBER_SYMBYTES);
   /* Compute public-key independent part of ciphertext */
-  indcpa_enc_c1(c1, fwd, seed, coins);
+  indcpa_enc_c1_fwd(c1, fwd, ctx, coins);
   return 0;
 }
 
@@ -104,6 +264,34 @@ int crypto_mkem_enc_c2(uint8_t *c2,
                        const uint8_t *pk,
                        const uint8_t *r,
                        const uint8_t *fwd)
+{
+  mkem_fwd tfwd;
+
+  indcpa_fwd_frombytes(&tfwd, fwd);
+  return crypto_mkem_enc_c2_fwd(c2, pk, r, &tfwd);
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_c2_fwd
+*
+* Description: Same as crypto_mkem_enc_c2, but takes the forwarded
+*              information as output by crypto_mkem_enc_c1_fwd
+*
+* Arguments:   - uint8_t *c2: pointer to output second ciphertext component
+*                (an already allocated array of MKYBER_C2BYTES bytes)
+*              - const uint8_t *pk: pointer to input public key
+*                (an array of MKYBER_PUBLICKEYBYTES bytes)
+*              - const uint8_t *r: pointer to input random coins;
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*              - const mkem_fwd *fwd: pointer to (secret) information forwarded
+*                by crypto_mkem_enc_c1_fwd
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_c2_fwd(uint8_t *c2,
+                           const uint8_t *pk,
+                           const uint8_t *r,
+                           const mkem_fwd *fwd)
 {
   uint8_t msg[KYBER_SYMBYTES];
   uint8_t coins2[KYBER_SYMBYTES];
@@ -117,10 +305,197 @@ int crypto_mkem_enc_c2(uint8_t *c2,
   memcpy(buf+MKYBER_INDCPA_PUBLICKEYBYTES,msg,KYBER_INDCPA_MSGBYTES);
   hash_h(coins2, buf, MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
 
-  indcpa_enc_c2(c2, msg, pk, fwd, coins2);
+  indcpa_enc_c2_fwd(c2, msg, pk, fwd, coins2);
   return 0;
 }
 
+/*************************************************
+* Name:        crypto_mkem_fwd_tobytes
+*
+* Description: Serializes forwarded information, e.g., to pass it
+*              to crypto_mkem_enc_c2 in another process
+*
+* Arguments:   - uint8_t *out: pointer to output byte array
+*                (an already allocated array of MKYBER_FWDBYTES bytes)
+*              - const mkem_fwd *fwd: pointer to input forwarded information
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_fwd_tobytes(uint8_t *out, const mkem_fwd *fwd)
+{
+  indcpa_fwd_tobytes(out, fwd);
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_fwd_frombytes
+*
+* Description: De-serializes forwarded information as output by
+*              crypto_mkem_enc_c1 or crypto_mkem_fwd_tobytes
+*
+* Arguments:   - mkem_fwd *fwd: pointer to output forwarded information
+*              - const uint8_t *in: pointer to input byte array
+*                (an array of MKYBER_FWDBYTES bytes)
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_fwd_frombytes(mkem_fwd *fwd, const uint8_t *in)
+{
+  indcpa_fwd_frombytes(fwd, in);
+  return 0;
+}
+
+/*************************************************
+* Name:        mkem_enc_c2_batch
+*
+* Description: Generates the second ciphertext components for a batch of
+*              public keys; shared by crypto_mkem_enc and the thread pool
+*
+* Arguments:   - uint8_t **c2s: array of num_keys pointers to output second
+*                ciphertext components (each of MKYBER_C2BYTES bytes)
+*              - const uint8_t *msg: pointer to input message
+*                (of length KYBER_SYMBYTES)
+*              - const mkem_fwd *fwd: pointer to (secret) information
+*                forwarded from the first ciphertext component
+*              - size_t num_keys: input batch size
+*              - uint8_t **pk: array of num_keys pointers to public keys,
+*                each pointing to an array of MKYBER_PUBLICKEYBYTES bytes
+**************************************************/
+void mkem_enc_c2_batch(uint8_t **c2s,
+                       const uint8_t msg[KYBER_SYMBYTES],
+                       const mkem_fwd *fwd,
+                       size_t num_keys,
+                       uint8_t *const* pk)
+{
+#ifdef KYBER_KECCAK8X
+  uint8_t coins2[8][KYBER_SYMBYTES];
+  uint8_t buf[8][MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES];
+  const uint8_t *in[8];
+  uint8_t *out[8];
+#else
+  uint8_t coins2[4][KYBER_SYMBYTES];
+  uint8_t buf[4][MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES];
+#endif
+  uint8_t dummy[4][MKYBER_C2BYTES];
+  uint8_t *c2x4[4];
+  const uint8_t *pkx4[4];
+  size_t i, j;
+
+  for(j=0;j<sizeof(buf)/sizeof(buf[0]);j++)
+    memcpy(buf[j]+MKYBER_INDCPA_PUBLICKEYBYTES,msg,KYBER_INDCPA_MSGBYTES);
+
+#ifdef KYBER_KECCAK8X
+  /* Full groups of eight recipients hash their coins2 in one pass of
+   * the 8-way Keccak and are then encrypted as two groups of four */
+  for(j=0;j<8;j++) {
+    in[j] = buf[j];
+    out[j] = coins2[j];
+  }
+  for(i=0;i+8<=num_keys;i+=8)
+  {
+    for(j=0;j<8;j++)
+      memcpy(buf[j],pk[i+j],MKYBER_INDCPA_PUBLICKEYBYTES);
+    PROFILE_START(t);
+    hash_h8x(out, in, MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
+    PROFILE_LAP(t, MKEM_PROFILE_HASH);
+
+    indcpa_enc_c2_4x(c2s+i, msg, (const uint8_t *const *)pk+i, fwd,
+                     (const uint8_t (*)[KYBER_SYMBYTES])coins2);
+    indcpa_enc_c2_4x(c2s+i+4, msg, (const uint8_t *const *)pk+i+4, fwd,
+                     (const uint8_t (*)[KYBER_SYMBYTES])coins2+4);
+  }
+#else
+  i = 0;
+#endif
+
+  /* Process recipients in groups of four; a remainder of two or three
+   * recipients is padded with copies of its first key whose outputs
+   * are discarded, a single remaining recipient uses the 1-way path */
+  for(;i+1<num_keys;i+=4)
+  {
+    for(j=0;j<4;j++) {
+      if(i+j < num_keys) {
+        pkx4[j] = pk[i+j];
+        c2x4[j] = c2s[i+j];
+      }
+      else {
+        pkx4[j] = pk[i];
+        c2x4[j] = dummy[j];
+      }
+    }
+
+    /* compute public-key dependent coins2 */
+    for(j=0;j<4;j++)
+      memcpy(buf[j],pkx4[j],MKYBER_INDCPA_PUBLICKEYBYTES);
+    PROFILE_START(t);
+    hash_h4x(coins2[0], coins2[1], coins2[2], coins2[3],
+             buf[0], buf[1], buf[2], buf[3],
+             MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
+    PROFILE_LAP(t, MKEM_PROFILE_HASH);
+
+    indcpa_enc_c2_4x(c2x4, msg, pkx4, fwd, (const uint8_t (*)[KYBER_SYMBYTES])coins2);
+  }
+
+  if(i<num_keys)
+  {
+    PROFILE_START(t);
+    memcpy(buf[0],pk[i],MKYBER_INDCPA_PUBLICKEYBYTES);
+    hash_h(coins2[0], buf[0], MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
+    PROFILE_LAP(t, MKEM_PROFILE_HASH);
+
+    indcpa_enc_c2_fwd(c2s[i], msg, pk[i], fwd, coins2[0]);
+  }
+}
+
+/*************************************************
+* Name:        mkem_enc_c2_strided
+*
+* Description: Same as mkem_enc_c2_batch for public keys and second
+*              ciphertext components stored at fixed distances in two
+*              buffers; shared by crypto_mkem_enc_strided and the key
+*              directories of mkem_keydir.c
+*
+* Arguments:   - uint8_t *c2s: pointer to the first output second
+*                ciphertext component (of MKYBER_C2BYTES bytes)
+*              - size_t c2stride: distance in bytes between two consecutive
+*                second ciphertext components
+*              - const uint8_t *msg: pointer to input message
+*                (of length KYBER_SYMBYTES)
+*              - const mkem_fwd *fwd: pointer to (secret) information
+*                forwarded from the first ciphertext component
+*              - size_t num_keys: input batch size
+*              - const uint8_t *pks: pointer to the first public key
+*                (of MKYBER_PUBLICKEYBYTES bytes)
+*              - size_t pkstride: distance in bytes between two consecutive
+*                public keys
+**************************************************/
+void mkem_enc_c2_strided(uint8_t *c2s,
+                         size_t c2stride,
+                         const uint8_t msg[KYBER_SYMBYTES],
+                         const mkem_fwd *fwd,
+                         size_t num_keys,
+                         const uint8_t *pks,
+                         size_t pkstride)
+{
+  /* Recipients per call of mkem_enc_c2_batch; a multiple of the
+   * widest grouping used there */
+  uint8_t *c2p[8];
+  uint8_t *pk[8];
+  size_t i, j, n;
+
+  for(i=0;i<num_keys;i+=n)
+  {
+    n = num_keys-i;
+    if(n > 8)
+      n = 8;
+    for(j=0;j<n;j++) {
+      c2p[j] = c2s+(i+j)*c2stride;
+      pk[j] = (uint8_t *)pks+(i+j)*pkstride;
+    }
+    mkem_enc_c2_batch(c2p, msg, fwd, n, pk);
+  }
+}
+
 /*************************************************
 * Name:        crypto_mkem_enc
 *
@@ -148,12 +523,113 @@ int crypto_mkem_enc(uint8_t *c1,
                     uint8_t *const* pk)
 {
   uint8_t msg[KYBER_SYMBYTES];
-  uint8_t fwd[MKYBER_FWDBYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+
+  randombytes(msg, KYBER_SYMBYTES);
+  PROFILE_START(t);
+  /* Don't release system RNG output */
+  hash_h(msg, msg, KYBER_SYMBYTES);
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, msg, KYBER_SYMBYTES);
+  PROFILE_LAP(t, MKEM_PROFILE_HASH);
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  mkem_enc_c2_batch(c2s, msg, &fwd, num_keys, pk);
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_prepare_recipient
+*
+* Description: Precomputes all recipient-dependent values that do not
+*              depend on the message: the public key unpacked into NTT
+*              domain (including the expanded fake public key) and the
+*              hash state after absorbing the public key
+*
+* Arguments:   - mkem_recipient *recipient: pointer to output prepared recipient
+*              - const uint8_t *pk: pointer to input public key
+*                (an array of MKYBER_PUBLICKEYBYTES bytes)
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_prepare_recipient(mkem_recipient *recipient,
+                                  const uint8_t *pk)
+{
+  indcpa_prepare_pk(&recipient->ppk, pk);
+
+  hash_h_init(&recipient->hpk);
+  hash_h_absorb(&recipient->hpk, pk, MKYBER_INDCPA_PUBLICKEYBYTES);
+  return 0;
+}
+
+/*************************************************
+* Name:        mkem_recipient_check
+*
+* Description: Checks a prepared recipient that was not produced by
+*              crypto_mkem_prepare_recipient in this process (e.g. read
+*              from a file): the absorb position of the hash state must be
+*              the one left by absorbing a public key, since the hash
+*              functions index the state with it, and the coefficients of
+*              the prepared public key must be reduced
+*
+* Arguments:   - const mkem_recipient *recipient: pointer to prepared recipient
+*
+* Returns 0 if the recipient can be used for encapsulation, -1 otherwise
+**************************************************/
+int mkem_recipient_check(const mkem_recipient *recipient)
+{
+  if(recipient->hpk.pos != MKYBER_INDCPA_PUBLICKEYBYTES % SHA3_256_RATE)
+    return -1;
+  return indcpa_check_prepared_pk(&recipient->ppk);
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_strided
+*
+* Description: Same as crypto_mkem_enc for public keys and second
+*              ciphertext components stored at fixed distances in two
+*              flat buffers, e.g., the output of crypto_mkem_keypair_batch
+*              and a buffer ready to be sent
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *c2s: pointer to output second ciphertext components;
+*                component i is written to c2s+i*c2stride
+*              - size_t c2stride: distance in bytes between two consecutive
+*                second ciphertext components (at least MKYBER_C2BYTES)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*              - size_t num_keys: input batch size
+*              - const uint8_t *pks: pointer to input public keys;
+*                key i is read from pks+i*pkstride
+*              - size_t pkstride: distance in bytes between two consecutive
+*                public keys (at least MKYBER_PUBLICKEYBYTES)
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_strided(uint8_t *c1,
+                            uint8_t *c2s,
+                            size_t c2stride,
+                            uint8_t *ss,
+                            const uint8_t *seed,
+                            size_t num_keys,
+                            const uint8_t *pks,
+                            size_t pkstride)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
   /* Will contain key, coins */
   uint8_t coins[KYBER_SYMBYTES];
-  uint8_t coins2[KYBER_SYMBYTES];
-  uint8_t buf[MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES];
-  size_t i;
 
   randombytes(msg, KYBER_SYMBYTES);
   /* Don't release system RNG output */
@@ -163,17 +639,128 @@ int crypto_mkem_enc(uint8_t *c1,
   /* Compute shared key as KDF(msg) */
   kdf(ss, msg, KYBER_SYMBYTES);
 
-  indcpa_enc_c1(c1, fwd, seed, coins);
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  mkem_enc_c2_strided(c2s, c2stride, msg, &fwd, num_keys, pks, pkstride);
+  return 0;
+}
+
+/*************************************************
+* Name:        mkem_enc_c2_prepared_batch
+*
+* Description: Generates the second ciphertext components for a batch of
+*              prepared recipients; shared by crypto_mkem_enc_prepared and
+*              the key directories of mkem_keydir.c
+*
+* Arguments:   - uint8_t **c2s: array of num_keys pointers to output second
+*                ciphertext components (each of MKYBER_C2BYTES bytes)
+*              - const uint8_t *msg: pointer to input message
+*                (of length KYBER_SYMBYTES)
+*              - const mkem_fwd *fwd: pointer to (secret) information
+*                forwarded from the first ciphertext component
+*              - size_t num_keys: input batch size
+*              - const mkem_recipient *recipients: pointer to the first
+*                prepared recipient
+*              - size_t stride: distance in bytes between two consecutive
+*                recipients (a multiple of 32)
+**************************************************/
+void mkem_enc_c2_prepared_batch(uint8_t **c2s,
+                                const uint8_t msg[KYBER_SYMBYTES],
+                                const mkem_fwd *fwd,
+                                size_t num_keys,
+                                const mkem_recipient *recipients,
+                                size_t stride)
+{
+  uint8_t coins2[4][KYBER_SYMBYTES];
+  uint8_t dummy[4][MKYBER_C2BYTES];
+  uint8_t *c2x4[4];
+  const indcpa_prepared_pk *ppkx4[4];
+  const mkem_recipient *rcpt;
+  hash_h_state state;
+  size_t i, j, k;
 
-  for(i=0;i<num_keys;i++)
+#define RECIPIENT(i) ((const mkem_recipient *)((const uint8_t *)recipients + (i)*stride))
+
+  /* Same grouping of recipients as in mkem_enc_c2_batch */
+  for(i=0;i+1<num_keys;i+=4)
   {
-    /* compute public-key dependent coins2 */
-    memcpy(buf,pk[i],MKYBER_INDCPA_PUBLICKEYBYTES);
-    memcpy(buf+MKYBER_INDCPA_PUBLICKEYBYTES,msg,KYBER_INDCPA_MSGBYTES);
-    hash_h(coins2, buf, MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
+    PROFILE_START(t);
+    for(j=0;j<4;j++) {
+      k = (i+j < num_keys) ? i+j : i;
+      rcpt = RECIPIENT(k);
+      ppkx4[j] = &rcpt->ppk;
+      c2x4[j] = (i+j < num_keys) ? c2s[i+j] : dummy[j];
+
+      /* compute public-key dependent coins2 from the cached H(pk) prefix */
+      state = rcpt->hpk;
+      hash_h_absorb(&state, msg, KYBER_INDCPA_MSGBYTES);
+      hash_h_finalize(coins2[j], &state);
+    }
+    PROFILE_LAP(t, MKEM_PROFILE_HASH);
 
-    indcpa_enc_c2(c2s[i], msg, pk[i], fwd, coins2);
+    indcpa_enc_c2_prepared_4x(c2x4, msg, ppkx4, fwd, (const uint8_t (*)[KYBER_SYMBYTES])coins2);
   }
+
+  if(i<num_keys)
+  {
+    PROFILE_START(t);
+    rcpt = RECIPIENT(i);
+    state = rcpt->hpk;
+    hash_h_absorb(&state, msg, KYBER_INDCPA_MSGBYTES);
+    hash_h_finalize(coins2[0], &state);
+    PROFILE_LAP(t, MKEM_PROFILE_HASH);
+
+    indcpa_enc_c2_prepared(c2s[i], msg, &rcpt->ppk, fwd, coins2[0]);
+  }
+
+#undef RECIPIENT
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_prepared
+*
+* Description: Same as crypto_mkem_enc, but for recipients prepared
+*              with crypto_mkem_prepare_recipient
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *c2: pointer to output second ciphertext components
+*                (an array of num_key pointers, each to an allocated array of MKYBER_C2BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*              - size_t num_keys: input batch size
+*              - const mkem_recipient *recipients: array of num_keys prepared recipients
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_prepared(uint8_t *c1,
+                             uint8_t **c2s,
+                             uint8_t *ss,
+                             const uint8_t *seed,
+                             size_t num_keys,
+                             const mkem_recipient *recipients)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+
+  randombytes(msg, KYBER_SYMBYTES);
+  /* Don't release system RNG output */
+  hash_h(msg, msg, KYBER_SYMBYTES);
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, msg, KYBER_SYMBYTES);
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  mkem_enc_c2_prepared_batch(c2s, msg, &fwd, num_keys, recipients, sizeof(mkem_recipient));
   return 0;
 }
 
@@ -197,6 +784,39 @@ int crypto_mkem_dec(uint8_t *ss,
                     const uint8_t *c1,
                     const uint8_t *c2,
                     const uint8_t *sk)
+{
+  mkem_seedctx ctx;
+  const uint8_t *seed = sk+MKYBER_INDCPA_SECRETKEYBYTES+MKYBER_INDCPA_PUBLICKEYBYTES;
+
+  crypto_mkem_seedctx_init(&ctx, seed);
+  return crypto_mkem_dec_ctx(ss, c1, c2, sk, &ctx);
+}
+
+/*************************************************
+* Name:        crypto_mkem_dec_ctx
+*
+* Description: Same as crypto_mkem_dec, but re-encryption uses the
+*              matrix from a seed context
+*
+* Arguments:   - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *c1: pointer to input first ciphertext component
+*                (an array of MKYBER_C1BYTES bytes)
+*              - const uint8_t *c2: pointer to input second ciphertext component
+*                (an array of MKYBER_C2BYTES bytes)
+*              - const uint8_t *sk: pointer to input private key
+*                (an already allocated array of MKYBER_SECRETKEYBYTES bytes)
+*              - const mkem_seedctx *ctx: pointer to seed context for the
+*                seed contained in sk
+*
+* Returns 0 (success) or -1 if ctx was initialized for a different seed
+* (ss is then zeroed)
+**************************************************/
+int crypto_mkem_dec_ctx(uint8_t *ss,
+                        const uint8_t *c1,
+                        const uint8_t *c2,
+                        const uint8_t *sk,
+                        const mkem_seedctx *ctx)
 {
   int fail;
   uint8_t msg[KYBER_SYMBYTES];
@@ -206,39 +826,163 @@ int crypto_mkem_dec(uint8_t *ss,
   uint8_t coins2[KYBER_SYMBYTES];
   uint8_t cmp1[MKYBER_C1BYTES];
   uint8_t cmp2[MKYBER_C2BYTES];
-  uint8_t fwd[MKYBER_FWDBYTES];
+  mkem_fwd fwd;
   uint8_t buf[KYBER_SYMBYTES+MKYBER_C1BYTES+MKYBER_C2BYTES];
   uint8_t buf2[MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES];
   const uint8_t *pk   = sk+MKYBER_INDCPA_SECRETKEYBYTES;
   const uint8_t *seed = pk+MKYBER_INDCPA_PUBLICKEYBYTES;
   const uint8_t *z = sk+ MKYBER_INDCPA_SECRETKEYBYTES + MKYBER_INDCPA_PUBLICKEYBYTES + KYBER_SYMBYTES;
 
+  /* The seed is public, no need for constant-time comparison; callers
+   * ignoring the return value get an all-zero key, not stack contents */
+  if(memcmp(seed, ctx->seed, KYBER_SYMBYTES)) {
+    memset(ss, 0, KYBER_SSBYTES);
+    return -1;
+  }
+
   indcpa_dec(msg, c1, c2, sk);
 
+  PROFILE_START(tp);
   /* Compute shared key as KDF(msg) */
   kdf(t, msg, KYBER_SYMBYTES);
 
   /* Re-encrypt */
   hash_h(coins, msg, KYBER_SYMBYTES);
-  indcpa_enc_c1(cmp1, fwd, seed, coins);
+  PROFILE_LAP(tp, MKEM_PROFILE_HASH);
+  indcpa_enc_c1_fwd(cmp1, &fwd, ctx, coins);
 
   /* compute public-key dependent coins2 */
+  PROFILE_RESTART(tp);
   memcpy(buf2,pk,MKYBER_INDCPA_PUBLICKEYBYTES);
   memcpy(buf2+MKYBER_INDCPA_PUBLICKEYBYTES,msg,KYBER_INDCPA_MSGBYTES);
   hash_h(coins2, buf2, MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
-  indcpa_enc_c2(cmp2, msg, pk, fwd, coins2);
+  PROFILE_LAP(tp, MKEM_PROFILE_HASH);
+  indcpa_enc_c2_fwd(cmp2, msg, pk, &fwd, coins2);
 
+  PROFILE_RESTART(tp);
   fail  = verify(c1, cmp1, MKYBER_C1BYTES);
   fail |= verify(c2, cmp2, MKYBER_C2BYTES);
+  PROFILE_LAP(tp, MKEM_PROFILE_VERIFY);
   
   /* Compute pseudorandom "rejection key" as H(z|c1|c2) */
   memcpy(buf, z, KYBER_SYMBYTES);
   memcpy(buf+KYBER_SYMBYTES, c1, MKYBER_C1BYTES);
   memcpy(buf+KYBER_SYMBYTES+MKYBER_C1BYTES, c2, MKYBER_C2BYTES);
   kdf(ss,buf,KYBER_SYMBYTES+MKYBER_C1BYTES+MKYBER_C2BYTES);
+  PROFILE_LAP(tp, MKEM_PROFILE_HASH);
 
   /* Overwrite randomness with shared key if re-encryption was successful */
   cmov(ss, t, KYBER_SYMBYTES, 1-fail);
+  PROFILE_LAP(tp, MKEM_PROFILE_VERIFY);
+
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_dec_batch
+*
+* Description: Decapsulates a batch of ciphertexts under the same secret key;
+*              equivalent to calling crypto_mkem_dec for every ciphertext.
+*              The secret key, public key and matrix are unpacked once and
+*              the re-encryptions run four at a time.
+*
+* Arguments:   - uint8_t **ss: array of num_cts pointers to output shared keys
+*                (each to an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t **c1s: array of num_cts pointers to input first
+*                ciphertext components (each of MKYBER_C1BYTES bytes)
+*              - const uint8_t **c2s: array of num_cts pointers to input second
+*                ciphertext components (each of MKYBER_C2BYTES bytes)
+*              - size_t num_cts: input batch size
+*              - const uint8_t *sk: pointer to input private key
+*                (an already allocated array of MKYBER_SECRETKEYBYTES bytes)
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_dec_batch(uint8_t **ss,
+                          const uint8_t *const* c1s,
+                          const uint8_t *const* c2s,
+                          size_t num_cts,
+                          const uint8_t *sk)
+{
+  int fail[4];
+  uint8_t msg[4][KYBER_SYMBYTES];
+  /* Will contain key, coins */
+  uint8_t t[KYBER_SYMBYTES];
+  uint8_t coins[4][KYBER_SYMBYTES];
+  uint8_t coins2[4][KYBER_SYMBYTES];
+  uint8_t cmp1[MKYBER_C1BYTES];
+  uint8_t cmp2[4][MKYBER_C2BYTES];
+  uint8_t buf[KYBER_SYMBYTES+MKYBER_C1BYTES+MKYBER_C2BYTES];
+  uint8_t *cmp2x4[4] = {cmp2[0], cmp2[1], cmp2[2], cmp2[3]};
+  const uint8_t *msgx4[4] = {msg[0], msg[1], msg[2], msg[3]};
+  const indcpa_fwd *fwdx4[4];
+  mkem_fwd fwd[4];
+  mkem_seedctx ctx;
+  indcpa_prepared_sk psk;
+  indcpa_prepared_pk ppk;
+  hash_h_state hpk, state;
+  const uint8_t *pk   = sk+MKYBER_INDCPA_SECRETKEYBYTES;
+  const uint8_t *seed = pk+MKYBER_INDCPA_PUBLICKEYBYTES;
+  const uint8_t *z = sk+ MKYBER_INDCPA_SECRETKEYBYTES + MKYBER_INDCPA_PUBLICKEYBYTES + KYBER_SYMBYTES;
+  size_t i, j, n;
+
+  indcpa_prepare_sk(&psk, sk);
+  indcpa_prepare_pk(&ppk, pk);
+  indcpa_seedctx_init(&ctx, seed);
+  hash_h_init(&hpk);
+  hash_h_absorb(&hpk, pk, MKYBER_INDCPA_PUBLICKEYBYTES);
+
+  for(j=0;j<4;j++)
+    fwdx4[j] = &fwd[j];
+
+  /* Process ciphertexts in groups of four; missing lanes of the last
+   * group repeat its first message and their results are discarded */
+  for(i=0;i<num_cts;i+=4)
+  {
+    n = (num_cts-i < 4) ? num_cts-i : 4;
+
+    for(j=0;j<n;j++)
+      indcpa_dec_prepared(msg[j], c1s[i+j], c2s[i+j], &psk);
+    for(;j<4;j++)
+      memcpy(msg[j], msg[0], KYBER_SYMBYTES);
+
+    /* Re-encrypt */
+    hash_h4x(coins[0], coins[1], coins[2], coins[3],
+             msg[0], msg[1], msg[2], msg[3], KYBER_SYMBYTES);
+
+    for(j=0;j<4;j++) {
+      /* compute public-key dependent coins2 from the cached H(pk) prefix */
+      state = hpk;
+      hash_h_absorb(&state, msg[j], KYBER_INDCPA_MSGBYTES);
+      hash_h_finalize(coins2[j], &state);
+    }
+
+    for(j=0;j<n;j++) {
+      /* c1 is compared right away, only the forwarded information is kept */
+      indcpa_enc_c1_fwd(cmp1, &fwd[j], &ctx, coins[j]);
+      fail[j] = verify(c1s[i+j], cmp1, MKYBER_C1BYTES);
+    }
+    for(;j<4;j++)
+      fwd[j] = fwd[0];
+
+    indcpa_enc_c2_samepk_4x(cmp2x4, msgx4, &ppk, fwdx4, (const uint8_t (*)[KYBER_SYMBYTES])coins2);
+
+    for(j=0;j<n;j++) {
+      fail[j] |= verify(c2s[i+j], cmp2[j], MKYBER_C2BYTES);
+
+      /* Compute shared key as KDF(msg) */
+      kdf(t, msg[j], KYBER_SYMBYTES);
+
+      /* Compute pseudorandom "rejection key" as H(z|c1|c2) */
+      memcpy(buf, z, KYBER_SYMBYTES);
+      memcpy(buf+KYBER_SYMBYTES, c1s[i+j], MKYBER_C1BYTES);
+      memcpy(buf+KYBER_SYMBYTES+MKYBER_C1BYTES, c2s[i+j], MKYBER_C2BYTES);
+      kdf(ss[i+j],buf,KYBER_SYMBYTES+MKYBER_C1BYTES+MKYBER_C2BYTES);
+
+      /* Overwrite randomness with shared key if re-encryption was successful */
+      cmov(ss[i+j], t, KYBER_SYMBYTES, 1-fail[j]);
+    }
+  }
 
   return 0;
 }
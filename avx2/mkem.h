@@ -1,14 +1,42 @@
 #ifndef KYBER_MKEM_H
 #define KYBER_MKEM_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "params.h"
+#include "indcpa.h"
+#include "symmetric.h"
+
+/* Recipient public key prepared for repeated encapsulation. The layout
+ * is internal to this implementation and may change, so do not store it
+ * yourself; keep the public key and prepare it again instead, or use a
+ * prepared key directory (mkem_keydir.h), which records the layout and
+ * is rejected by builds that use a different one. Contains 32-byte
+ * aligned vector types, so heap-allocated arrays need aligned_alloc or
+ * posix_memalign. */
+typedef struct {
+  indcpa_prepared_pk ppk;
+  hash_h_state hpk;
+} mkem_recipient;
+
+/* Expanded public matrix for one seed; same alignment requirements */
+typedef indcpa_seedctx mkem_seedctx;
+
+/* Information forwarded from enc_c1 to enc_c2 kept in NTT domain;
+ * same alignment requirements */
+typedef indcpa_fwd mkem_fwd;
 
 int crypto_mkem_keypair(uint8_t *pk, 
                         uint8_t *sk, 
                         const uint8_t *seed);
 
 
+int crypto_mkem_keypair_batch(uint8_t *pks,
+                              uint8_t *sks,
+                              size_t num_keys,
+                              const uint8_t *seed);
+
+
 int crypto_mkem_enc_c1(uint8_t *c1,
                        uint8_t *ss,
                        uint8_t *fwd,
@@ -16,12 +44,44 @@ int crypto_mkem_enc_c1(uint8_t *c1,
                        const uint8_t *r);
 
 
+int crypto_mkem_seedctx_init(mkem_seedctx *ctx,
+                             const uint8_t *seed);
+
+
+int crypto_mkem_enc_c1_ctx(uint8_t *c1,
+                           uint8_t *ss,
+                           uint8_t *fwd,
+                           const mkem_seedctx *ctx,
+                           const uint8_t *r);
+
+
+int crypto_mkem_enc_c1_fwd(uint8_t *c1,
+                           uint8_t *ss,
+                           mkem_fwd *fwd,
+                           const mkem_seedctx *ctx,
+                           const uint8_t *r);
+
+
 int crypto_mkem_enc_c2(uint8_t *c2,
                        const uint8_t *pk,
                        const uint8_t *r,
                        const uint8_t *fwd);
 
 
+int crypto_mkem_enc_c2_fwd(uint8_t *c2,
+                           const uint8_t *pk,
+                           const uint8_t *r,
+                           const mkem_fwd *fwd);
+
+
+int crypto_mkem_fwd_tobytes(uint8_t *out,
+                            const mkem_fwd *fwd);
+
+
+int crypto_mkem_fwd_frombytes(mkem_fwd *fwd,
+                              const uint8_t *in);
+
+
 int crypto_mkem_enc(uint8_t *c1,
                     uint8_t **c2s,
                     uint8_t *ss,
@@ -30,9 +90,45 @@ int crypto_mkem_enc(uint8_t *c1,
                     uint8_t *const* pk);
 
 
+int crypto_mkem_enc_strided(uint8_t *c1,
+                            uint8_t *c2s,
+                            size_t c2stride,
+                            uint8_t *ss,
+                            const uint8_t *seed,
+                            size_t num_keys,
+                            const uint8_t *pks,
+                            size_t pkstride);
+
+
+int crypto_mkem_prepare_recipient(mkem_recipient *recipient,
+                                  const uint8_t *pk);
+
+
+int crypto_mkem_enc_prepared(uint8_t *c1,
+                             uint8_t **c2s,
+                             uint8_t *ss,
+                             const uint8_t *seed,
+                             size_t num_keys,
+                             const mkem_recipient *recipients);
+
+
 int crypto_mkem_dec(uint8_t *ss,
                     const uint8_t *c1,
                     const uint8_t *c2,
                     const uint8_t *sk);
 
+
+int crypto_mkem_dec_ctx(uint8_t *ss,
+                        const uint8_t *c1,
+                        const uint8_t *c2,
+                        const uint8_t *sk,
+                        const mkem_seedctx *ctx);
+
+
+int crypto_mkem_dec_batch(uint8_t **ss,
+                          const uint8_t *const* c1s,
+                          const uint8_t *const* c2s,
+                          size_t num_cts,
+                          const uint8_t *sk);
+
 #endif
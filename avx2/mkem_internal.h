@@ -0,0 +1,43 @@
+#ifndef KYBER_MKEM_INTERNAL_H
+#define KYBER_MKEM_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "params.h"
+#include "mkem.h"
+
+/* Helpers shared by the implementation files of the API in mkem.h,
+ * mkem_pool.h, mkem_keydir.h and mkem_session.h; not part of the API */
+
+/* Used by crypto_mkem_enc, the thread pool in mkem_pool.c, the group
+ * sessions in mkem_session.c and mkem_enc_c2_strided */
+void mkem_enc_c2_batch(uint8_t **c2s,
+                       const uint8_t msg[KYBER_SYMBYTES],
+                       const mkem_fwd *fwd,
+                       size_t num_keys,
+                       uint8_t *const* pk);
+
+
+/* Used by crypto_mkem_enc_strided and the key directories in mkem_keydir.c */
+void mkem_enc_c2_strided(uint8_t *c2s,
+                         size_t c2stride,
+                         const uint8_t msg[KYBER_SYMBYTES],
+                         const mkem_fwd *fwd,
+                         size_t num_keys,
+                         const uint8_t *pks,
+                         size_t pkstride);
+
+
+/* Used by crypto_mkem_enc_prepared and the key directories in mkem_keydir.c */
+void mkem_enc_c2_prepared_batch(uint8_t **c2s,
+                                const uint8_t msg[KYBER_SYMBYTES],
+                                const mkem_fwd *fwd,
+                                size_t num_keys,
+                                const mkem_recipient *recipients,
+                                size_t stride);
+
+
+/* Used by the key directories in mkem_keydir.c for prepared records */
+int mkem_recipient_check(const mkem_recipient *recipient);
+
+#endif
@@ -0,0 +1,455 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "params.h"
+#include "mkem.h"
+#include "mkem_keydir.h"
+#include "mkem_internal.h"
+#include "indcpa.h"
+#include "symmetric.h"
+#include "randombytes.h"
+
+/* Recipients per call of the batch functions; the records of the next
+ * chunk are prefetched while the current one is encrypted */
+#define KEYDIR_CHUNK 8
+/* Recipients per window; the kernel is asked to read ahead the records of
+ * the next window, and crypto_mkem_enc_keydir_fd writes the second
+ * ciphertext components of one window at a time */
+#define KEYDIR_WINDOW 64
+
+static void store32_le(uint8_t x[4], uint32_t u)
+{
+  unsigned int i;
+  for(i=0;i<4;i++)
+    x[i] = u >> 8*i;
+}
+
+static uint32_t load32_le(const uint8_t x[4])
+{
+  unsigned int i;
+  uint32_t r = 0;
+  for(i=0;i<4;i++)
+    r |= (uint32_t)x[i] << 8*i;
+  return r;
+}
+
+static void store64_le(uint8_t x[8], uint64_t u)
+{
+  unsigned int i;
+  for(i=0;i<8;i++)
+    x[i] = u >> 8*i;
+}
+
+static uint64_t load64_le(const uint8_t x[8])
+{
+  unsigned int i;
+  uint64_t r = 0;
+  for(i=0;i<8;i++)
+    r |= (uint64_t)x[i] << 8*i;
+  return r;
+}
+
+/*************************************************
+* Name:        keydir_layout
+*
+* Description: Computes the header bytes 64..95 describing the layout of
+*              the cached mkem_recipient of prepared records
+*
+* Arguments:   - uint8_t *r: pointer to output array of 32 bytes
+*              - uint32_t flags: flags of the directory
+**************************************************/
+static void keydir_layout(uint8_t r[32], uint32_t flags)
+{
+  memset(r, 0, 32);
+  if(flags & MKEM_KEYDIR_PREPARED) {
+    store32_le(r+0, sizeof(mkem_recipient));
+    store32_le(r+4, offsetof(mkem_recipient, hpk));
+    store32_le(r+8, MKEM_KEYDIR_LAYOUT);
+  }
+}
+
+/*************************************************
+* Name:        write_all
+*
+* Description: Writes a buffer to a file descriptor, retrying after
+*              short writes and interruptions by signals
+*
+* Arguments:   - int fd: file descriptor
+*              - const uint8_t *buf: pointer to input buffer
+*              - size_t len: length of the buffer
+*
+* Returns 0 on success, -1 on failure
+**************************************************/
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+  ssize_t n;
+
+  while(len > 0) {
+    n = write(fd, buf, len);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_keydir_write
+*
+* Description: Writes a key directory for keys sharing the same public seed
+*
+* Arguments:   - int fd: file descriptor to write the directory to
+*              - const uint8_t *seed: pointer to the public seed of the keys
+*                (of length KYBER_SYMBYTES)
+*              - const uint8_t *pks: pointer to num_keys contiguous public keys
+*                (an array of num_keys*MKYBER_PUBLICKEYBYTES bytes)
+*              - size_t num_keys: number of public keys
+*              - uint32_t flags: 0, or MKEM_KEYDIR_PREPARED to store every key
+*                together with the output of crypto_mkem_prepare_recipient
+*
+* Returns 0 on success, -1 on failure
+**************************************************/
+int crypto_mkem_keydir_write(int fd,
+                             const uint8_t *seed,
+                             const uint8_t *pks,
+                             size_t num_keys,
+                             uint32_t flags)
+{
+  uint8_t hdr[MKEM_KEYDIR_HEADERBYTES];
+  uint8_t pad[32] = {0};
+  mkem_recipient rcpt;
+  size_t i, recordbytes;
+
+  if(flags & ~(uint32_t)MKEM_KEYDIR_PREPARED)
+    return -1;
+  recordbytes = (flags & MKEM_KEYDIR_PREPARED) ? MKEM_KEYDIR_PREPAREDBYTES : MKYBER_PUBLICKEYBYTES;
+
+  memcpy(hdr, MKEM_KEYDIR_MAGIC, 8);
+  store32_le(hdr+8, MKEM_KEYDIR_VERSION);
+  store32_le(hdr+12, KYBER_K);
+  store32_le(hdr+16, flags);
+  store32_le(hdr+20, recordbytes);
+  store64_le(hdr+24, num_keys);
+  memcpy(hdr+32, seed, KYBER_SYMBYTES);
+  keydir_layout(hdr+64, flags);
+  if(write_all(fd, hdr, sizeof(hdr)))
+    return -1;
+
+  if(!(flags & MKEM_KEYDIR_PREPARED))
+    return write_all(fd, pks, num_keys*MKYBER_PUBLICKEYBYTES);
+
+  /* Do not write uninitialized padding bytes */
+  memset(&rcpt, 0, sizeof(rcpt));
+  for(i=0;i<num_keys;i++) {
+    crypto_mkem_prepare_recipient(&rcpt, pks+i*MKYBER_PUBLICKEYBYTES);
+    if(write_all(fd, (const uint8_t *)&rcpt, sizeof(rcpt))
+       || write_all(fd, pks+i*MKYBER_PUBLICKEYBYTES, MKYBER_PUBLICKEYBYTES)
+       || write_all(fd, pad, recordbytes-sizeof(rcpt)-MKYBER_PUBLICKEYBYTES))
+      return -1;
+  }
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_keydir_open
+*
+* Description: Maps a key directory read-only into memory and checks
+*              its header and, with MKEM_KEYDIR_PREPARED, every record
+*              (which reads the whole file once)
+*
+* Arguments:   - mkem_keydir *dir: pointer to output directory
+*              - const char *path: path of the directory file
+*
+* Returns 0 on success, -1 if the file cannot be mapped, was written for
+* a different format version, parameter set or layout of mkem_recipient,
+* is truncated or contains a corrupted prepared record
+**************************************************/
+int crypto_mkem_keydir_open(mkem_keydir *dir, const char *path)
+{
+  struct stat st;
+  uint8_t layout[32];
+  const uint8_t *map;
+  size_t len, recordbytes;
+  uint64_t num_keys, i;
+  uint32_t flags;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0)
+    return -1;
+  if(fstat(fd, &st) || st.st_size < MKEM_KEYDIR_HEADERBYTES) {
+    close(fd);
+    return -1;
+  }
+  len = st.st_size;
+  map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    return -1;
+
+  flags = load32_le(map+16);
+  recordbytes = load32_le(map+20);
+  num_keys = load64_le(map+24);
+  keydir_layout(layout, flags);
+  if(memcmp(map, MKEM_KEYDIR_MAGIC, 8)
+     || load32_le(map+8) != MKEM_KEYDIR_VERSION
+     || load32_le(map+12) != KYBER_K
+     || (flags & ~(uint32_t)MKEM_KEYDIR_PREPARED)
+     || memcmp(map+64, layout, sizeof(layout))
+     || recordbytes != ((flags & MKEM_KEYDIR_PREPARED) ? MKEM_KEYDIR_PREPAREDBYTES : MKYBER_PUBLICKEYBYTES)
+     || num_keys > (len-MKEM_KEYDIR_HEADERBYTES)/recordbytes) {
+    munmap((void *)map, len);
+    return -1;
+  }
+
+  /* Records are read once from front to back */
+  madvise((void *)map, len, MADV_SEQUENTIAL);
+
+  /* Prepared records are used as they are, so reject any whose hash
+   * state or coefficients crypto_mkem_prepare_recipient cannot have
+   * produced */
+  if(flags & MKEM_KEYDIR_PREPARED)
+    for(i=0;i<num_keys;i++)
+      if(mkem_recipient_check((const mkem_recipient *)(map+MKEM_KEYDIR_HEADERBYTES+i*recordbytes))) {
+        munmap((void *)map, len);
+        return -1;
+      }
+
+  dir->seed = map+32;
+  dir->num_keys = num_keys;
+  dir->map = map;
+  dir->maplen = len;
+  dir->records = map+MKEM_KEYDIR_HEADERBYTES;
+  dir->recordbytes = recordbytes;
+  dir->flags = flags;
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_keydir_close
+*
+* Description: Unmaps a key directory opened with crypto_mkem_keydir_open
+*
+* Arguments:   - mkem_keydir *dir: pointer to the directory
+**************************************************/
+void crypto_mkem_keydir_close(mkem_keydir *dir)
+{
+  munmap((void *)dir->map, dir->maplen);
+  memset(dir, 0, sizeof(mkem_keydir));
+}
+
+/*************************************************
+* Name:        crypto_mkem_keydir_pk
+*
+* Description: Returns the public key of a record of a key directory
+*
+* Arguments:   - const mkem_keydir *dir: pointer to the directory
+*              - size_t i: index of the record (less than dir->num_keys)
+*
+* Returns pointer to MKYBER_PUBLICKEYBYTES bytes inside the mapping
+**************************************************/
+const uint8_t *crypto_mkem_keydir_pk(const mkem_keydir *dir, size_t i)
+{
+  const uint8_t *rec = dir->records + i*dir->recordbytes;
+
+  if(dir->flags & MKEM_KEYDIR_PREPARED)
+    rec += sizeof(mkem_recipient);
+  return rec;
+}
+
+/*************************************************
+* Name:        keydir_prefetch
+*
+* Description: Prefetches the records [begin,end) into the L2 cache;
+*              indices beyond the end of the directory are ignored
+**************************************************/
+static void keydir_prefetch(const mkem_keydir *dir, size_t begin, size_t end)
+{
+  const char *p, *q;
+
+  if(end > dir->num_keys)
+    end = dir->num_keys;
+  if(begin >= end)
+    return;
+
+  p = (const char *)dir->records + begin*dir->recordbytes;
+  q = (const char *)dir->records + end*dir->recordbytes;
+  for(;p<q;p+=64)
+    _mm_prefetch(p, _MM_HINT_T1);
+}
+
+/*************************************************
+* Name:        keydir_willneed
+*
+* Description: Asks the kernel to read the pages of the records
+*              [begin,end) ahead; indices beyond the end of the directory
+*              are ignored
+**************************************************/
+static void keydir_willneed(const mkem_keydir *dir, size_t begin, size_t end)
+{
+  uintptr_t p, q, pagesize = sysconf(_SC_PAGESIZE);
+
+  if(end > dir->num_keys)
+    end = dir->num_keys;
+  if(begin >= end)
+    return;
+
+  p = (uintptr_t)(dir->records + begin*dir->recordbytes) & ~(pagesize-1);
+  q = (uintptr_t)(dir->records + end*dir->recordbytes);
+  madvise((void *)p, q-p, MADV_WILLNEED);
+}
+
+/*************************************************
+* Name:        keydir_enc_c2
+*
+* Description: Computes the contiguous second ciphertext components of
+*              at most KEYDIR_CHUNK consecutive records
+*
+* Arguments:   - uint8_t *c2: pointer to output array of n*MKYBER_C2BYTES bytes
+*              - const uint8_t *msg: pointer to input message
+*              - const mkem_fwd *fwd: pointer to forwarded information
+*              - const mkem_keydir *dir: pointer to the directory
+*              - size_t begin: index of the first record
+*              - size_t n: number of records
+**************************************************/
+static void keydir_enc_c2(uint8_t *c2,
+                          const uint8_t msg[KYBER_SYMBYTES],
+                          const mkem_fwd *fwd,
+                          const mkem_keydir *dir,
+                          size_t begin,
+                          size_t n)
+{
+  uint8_t *c2p[KEYDIR_CHUNK];
+  const uint8_t *rec = dir->records + begin*dir->recordbytes;
+  size_t j;
+
+  if(!(dir->flags & MKEM_KEYDIR_PREPARED)) {
+    mkem_enc_c2_strided(c2, MKYBER_C2BYTES, msg, fwd, n, rec, dir->recordbytes);
+    return;
+  }
+
+  for(j=0;j<n;j++)
+    c2p[j] = c2 + j*MKYBER_C2BYTES;
+  mkem_enc_c2_prepared_batch(c2p, msg, fwd, n, (const mkem_recipient *)rec, dir->recordbytes);
+}
+
+/*************************************************
+* Name:        keydir_enc
+*
+* Description: Encapsulates to all keys of a directory, walking the
+*              records sequentially; the second ciphertext components
+*              go to c2s if it is not NULL and to fd otherwise
+*
+* Returns 0 on success, -1 if writing to fd failed
+**************************************************/
+static int keydir_enc(uint8_t *c1,
+                      uint8_t *c2s,
+                      int fd,
+                      uint8_t *ss,
+                      const mkem_keydir *dir)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+  uint8_t window[KEYDIR_WINDOW*MKYBER_C2BYTES];
+  uint8_t *c2;
+  size_t i, j, n, m;
+
+  randombytes(msg, KYBER_SYMBYTES);
+  /* Don't release system RNG output */
+  hash_h(msg, msg, KYBER_SYMBYTES);
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, msg, KYBER_SYMBYTES);
+
+  indcpa_seedctx_init(&ctx, dir->seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  for(i=0;i<dir->num_keys;i+=n)
+  {
+    n = dir->num_keys-i;
+    if(n > KEYDIR_WINDOW)
+      n = KEYDIR_WINDOW;
+    keydir_willneed(dir, i+n, i+n+KEYDIR_WINDOW);
+
+    c2 = (c2s != NULL) ? c2s+i*MKYBER_C2BYTES : window;
+    for(j=0;j<n;j+=m)
+    {
+      m = n-j;
+      if(m > KEYDIR_CHUNK)
+        m = KEYDIR_CHUNK;
+      keydir_prefetch(dir, i+j+m, i+j+m+KEYDIR_CHUNK);
+      keydir_enc_c2(c2+j*MKYBER_C2BYTES, msg, &fwd, dir, i+j, m);
+    }
+
+    /* Do not leave a shared key for a partly written ciphertext */
+    if(c2s == NULL && write_all(fd, window, n*MKYBER_C2BYTES)) {
+      memset(ss, 0, KYBER_SSBYTES);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_keydir
+*
+* Description: Same as crypto_mkem_enc for all keys of a key directory,
+*              using the seed stored in the directory; the second
+*              ciphertext components are written contiguously
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *c2s: pointer to output second ciphertext components
+*                (an array of dir->num_keys*MKYBER_C2BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const mkem_keydir *dir: pointer to the directory
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_keydir(uint8_t *c1,
+                           uint8_t *c2s,
+                           uint8_t *ss,
+                           const mkem_keydir *dir)
+{
+  return keydir_enc(c1, c2s, -1, ss, dir);
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_keydir_fd
+*
+* Description: Same as crypto_mkem_enc_keydir, but the second ciphertext
+*              components are written in directory order to a file
+*              descriptor (dir->num_keys*MKYBER_C2BYTES bytes in total)
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - int fd: file descriptor for the second ciphertext components
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const mkem_keydir *dir: pointer to the directory
+*
+* Returns 0 on success, -1 if writing to fd failed (ss is then zeroed)
+**************************************************/
+int crypto_mkem_enc_keydir_fd(uint8_t *c1,
+                              int fd,
+                              uint8_t *ss,
+                              const mkem_keydir *dir)
+{
+  return keydir_enc(c1, NULL, fd, ss, dir);
+}
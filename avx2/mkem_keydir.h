@@ -0,0 +1,82 @@
+#ifndef KYBER_MKEM_KEYDIR_H
+#define KYBER_MKEM_KEYDIR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "params.h"
+#include "mkem.h"
+
+/* On-disk key directory: a header of MKEM_KEYDIR_HEADERBYTES bytes
+ * followed by num_keys records of equal length. Header fields:
+ *   bytes  0.. 7: MKEM_KEYDIR_MAGIC
+ *   bytes  8..11: format version (little endian)
+ *   bytes 12..15: KYBER_K (little endian)
+ *   bytes 16..19: flags (little endian)
+ *   bytes 20..23: length of one record (little endian)
+ *   bytes 24..31: number of records (little endian)
+ *   bytes 32..63: public seed shared by all keys
+ *   bytes 64..95: layout of the cached mkem_recipient, see below
+ * A record is a public key of MKYBER_PUBLICKEYBYTES bytes. With
+ * MKEM_KEYDIR_PREPARED, it is an mkem_recipient followed by the public
+ * key, padded to a multiple of 32 bytes. Since the layout of
+ * mkem_recipient is internal, bytes 64..67 then hold its size, bytes
+ * 68..71 the offset of its hash state and bytes 72..75
+ * MKEM_KEYDIR_LAYOUT (all little endian); crypto_mkem_keydir_open
+ * rejects files whose values differ from those of the reading build.
+ * The cached values are not compared with the public keys, so prepared
+ * files have to come from a trusted writer. The remaining header bytes
+ * are zero. */
+#define MKEM_KEYDIR_MAGIC "MKYBERKD"
+#define MKEM_KEYDIR_VERSION 2
+#define MKEM_KEYDIR_HEADERBYTES 96
+
+/* Increment whenever the contents of mkem_recipient change in a way
+ * that keeps its size, e.g. the order of the prepared coefficients */
+#define MKEM_KEYDIR_LAYOUT 1
+
+#define MKEM_KEYDIR_PREPARED 1
+#define MKEM_KEYDIR_PREPAREDBYTES \
+  ((sizeof(mkem_recipient)+MKYBER_PUBLICKEYBYTES+31) & ~(size_t)31)
+
+/* Read-only view of a key directory mapped into memory;
+ * seed and num_keys may be read, the other fields are private */
+typedef struct {
+  const uint8_t *seed;
+  size_t num_keys;
+  const uint8_t *map;
+  size_t maplen;
+  const uint8_t *records;
+  size_t recordbytes;
+  uint32_t flags;
+} mkem_keydir;
+
+int crypto_mkem_keydir_write(int fd,
+                             const uint8_t *seed,
+                             const uint8_t *pks,
+                             size_t num_keys,
+                             uint32_t flags);
+
+
+int crypto_mkem_keydir_open(mkem_keydir *dir,
+                            const char *path);
+
+
+void crypto_mkem_keydir_close(mkem_keydir *dir);
+
+
+const uint8_t *crypto_mkem_keydir_pk(const mkem_keydir *dir,
+                                     size_t i);
+
+
+int crypto_mkem_enc_keydir(uint8_t *c1,
+                           uint8_t *c2s,
+                           uint8_t *ss,
+                           const mkem_keydir *dir);
+
+
+int crypto_mkem_enc_keydir_fd(uint8_t *c1,
+                              int fd,
+                              uint8_t *ss,
+                              const mkem_keydir *dir);
+
+#endif
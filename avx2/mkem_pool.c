@@ -0,0 +1,638 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "params.h"
+#include "mkem.h"
+#include "mkem_pool.h"
+#include "mkem_internal.h"
+#include "indcpa.h"
+#include "symmetric.h"
+#include "randombytes.h"
+
+typedef struct {
+  mkem_pool *pool;
+  unsigned int id;
+  pthread_t thread;
+} mkem_worker;
+
+struct mkem_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned long generation;
+  unsigned int pending;
+  int shutdown;
+
+  /* Current job, constant while pending > 0 */
+  uint8_t **c2s;
+  uint8_t *const* pk;
+  const uint8_t *msg;
+  const mkem_fwd *fwd;
+  size_t num_keys;
+  size_t chunk;
+
+  /* Pipelined jobs publish fwd only after the workers have started,
+   * see crypto_mkem_enc_pipelined */
+  pthread_cond_t fwdcond;
+  int fwd_ready;
+  int pipelined;
+
+  unsigned int nthreads;
+  mkem_worker workers[];
+};
+
+/*************************************************
+* Name:        worker_pipelined
+*
+* Description: Computes the share [begin,end) of a pipelined job. The first
+*              four recipients are unpacked (including the expansion of
+*              the fake public keys) and their coins are derived before
+*              the forwarded information is published; the worker then
+*              waits for it and continues like mkem_enc_c2_batch.
+*
+* Arguments:   - mkem_pool *pool: pointer to the pool
+*              - size_t begin: index of the first recipient of the share
+*              - size_t end: index after the last recipient of the share
+**************************************************/
+static void worker_pipelined(mkem_pool *pool, size_t begin, size_t end)
+{
+  indcpa_prepared_pk ppk[4];
+  const indcpa_prepared_pk *ppkx4[4];
+  uint8_t coins2[4][KYBER_SYMBYTES];
+  uint8_t buf[MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES];
+  uint8_t *c2x4[4];
+  size_t j, n;
+
+  n = end-begin;
+  if(n > 4)
+    n = 4;
+
+  memcpy(buf+MKYBER_INDCPA_PUBLICKEYBYTES, pool->msg, KYBER_INDCPA_MSGBYTES);
+  for(j=0;j<n;j++) {
+    indcpa_prepare_pk(&ppk[j], pool->pk[begin+j]);
+    memcpy(buf, pool->pk[begin+j], MKYBER_INDCPA_PUBLICKEYBYTES);
+    hash_h(coins2[j], buf, MKYBER_INDCPA_PUBLICKEYBYTES+KYBER_INDCPA_MSGBYTES);
+    ppkx4[j] = &ppk[j];
+    c2x4[j] = pool->c2s[begin+j];
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  while(!pool->fwd_ready)
+    pthread_cond_wait(&pool->fwdcond, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+
+  if(n == 4)
+    indcpa_enc_c2_prepared_4x(c2x4, pool->msg, ppkx4, pool->fwd, (const uint8_t (*)[KYBER_SYMBYTES])coins2);
+  else
+    for(j=0;j<n;j++)
+      indcpa_enc_c2_prepared(c2x4[j], pool->msg, ppkx4[j], pool->fwd, coins2[j]);
+
+  if(begin+n < end)
+    mkem_enc_c2_batch(pool->c2s+begin+n, pool->msg, pool->fwd, end-begin-n, pool->pk+begin+n);
+}
+
+/*************************************************
+* Name:        worker_main
+*
+* Description: Main loop of a worker thread; waits for a new job and
+*              computes the contiguous share of recipients given by its id.
+*              The polynomial vectors used by mkem_enc_c2_batch live on the
+*              stack of the long-lived thread and are reused for every job.
+*
+* Arguments:   - void *arg: pointer to the mkem_worker of this thread
+**************************************************/
+static void *worker_main(void *arg)
+{
+  mkem_worker *w = arg;
+  mkem_pool *pool = w->pool;
+  unsigned long seen = 0;
+  size_t begin, end;
+
+  pthread_mutex_lock(&pool->lock);
+  for(;;) {
+    while(pool->generation == seen && !pool->shutdown)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if(pool->shutdown)
+      break;
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    begin = w->id*pool->chunk;
+    end = begin+pool->chunk;
+    if(end > pool->num_keys)
+      end = pool->num_keys;
+    if(begin < end && pool->pipelined)
+      worker_pipelined(pool, begin, end);
+    else if(begin < end)
+      mkem_enc_c2_batch(pool->c2s+begin, pool->msg, pool->fwd, end-begin, pool->pk+begin);
+
+    pthread_mutex_lock(&pool->lock);
+    if(--pool->pending == 0)
+      pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+/*************************************************
+* Name:        pool_stop
+*
+* Description: Terminates and joins the first n workers of a pool
+*
+* Arguments:   - mkem_pool *pool: pointer to the pool
+*              - unsigned int n: number of running workers
+**************************************************/
+static void pool_stop(mkem_pool *pool, unsigned int n)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(i=0;i<n;i++)
+    pthread_join(pool->workers[i].thread, NULL);
+}
+
+/*************************************************
+* Name:        pool_start
+*
+* Description: Shards the recipients across all workers of the pool and
+*              starts them. Shares are multiples of four recipients so
+*              that all but the last one run entirely on the 4-way code
+*              path. For pipelined jobs, the workers wait for
+*              pool_publish_fwd before they use fwd.
+*
+* Arguments:   - mkem_pool *pool: pointer to the pool
+*              - uint8_t **c2s: array of num_keys pointers to output second
+*                ciphertext components (each of MKYBER_C2BYTES bytes)
+*              - const uint8_t *msg: pointer to input message
+*              - const mkem_fwd *fwd: pointer to forwarded information
+*              - size_t num_keys: input batch size
+*              - uint8_t **pk: array of num_keys pointers to public keys
+*              - int pipelined: 1 for a pipelined job, 0 otherwise
+**************************************************/
+static void pool_start(mkem_pool *pool,
+                       uint8_t **c2s,
+                       const uint8_t msg[KYBER_SYMBYTES],
+                       const mkem_fwd *fwd,
+                       size_t num_keys,
+                       uint8_t *const* pk,
+                       int pipelined)
+{
+  size_t chunk;
+
+  chunk = (num_keys+pool->nthreads-1)/pool->nthreads;
+  chunk = (chunk+3) & ~(size_t)3;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->c2s = c2s;
+  pool->pk = pk;
+  pool->msg = msg;
+  pool->fwd = fwd;
+  pool->num_keys = num_keys;
+  pool->chunk = chunk;
+  pool->pipelined = pipelined;
+  pool->fwd_ready = !pipelined;
+  pool->pending = pool->nthreads;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/*************************************************
+* Name:        pool_publish_fwd
+*
+* Description: Lets the workers of a pipelined job use the forwarded
+*              information, which must not change afterwards
+*
+* Arguments:   - mkem_pool *pool: pointer to the pool
+**************************************************/
+static void pool_publish_fwd(mkem_pool *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->fwd_ready = 1;
+  pthread_cond_broadcast(&pool->fwdcond);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/*************************************************
+* Name:        pool_wait
+*
+* Description: Waits until every worker has finished its share
+*
+* Arguments:   - mkem_pool *pool: pointer to the pool
+**************************************************/
+static void pool_wait(mkem_pool *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while(pool->pending)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/*************************************************
+* Name:        pool_run
+*
+* Description: Computes the second ciphertext components of all
+*              recipients with the workers of the pool
+*
+* Arguments:   see pool_start
+**************************************************/
+static void pool_run(mkem_pool *pool,
+                     uint8_t **c2s,
+                     const uint8_t msg[KYBER_SYMBYTES],
+                     const mkem_fwd *fwd,
+                     size_t num_keys,
+                     uint8_t *const* pk)
+{
+  pool_start(pool, c2s, msg, fwd, num_keys, pk, 0);
+  pool_wait(pool);
+}
+
+/*************************************************
+* Name:        crypto_mkem_pool_new
+*
+* Description: Starts a pool of worker threads for crypto_mkem_enc_pool
+*              and crypto_mkem_enc_c2_pool
+*
+* Arguments:   - unsigned int nthreads: number of worker threads (at least 1)
+*              - const int *cpus: NULL, or array of nthreads CPU numbers
+*                (each at least 0 and less than CPU_SETSIZE);
+*                worker i is pinned to CPU cpus[i]
+*
+* Returns pointer to the pool, or NULL on failure or invalid CPU numbers
+**************************************************/
+mkem_pool *crypto_mkem_pool_new(unsigned int nthreads, const int *cpus)
+{
+  mkem_pool *pool;
+  pthread_attr_t attr;
+  cpu_set_t cpuset;
+  unsigned int i;
+  int err = 0;
+
+  if(nthreads == 0)
+    return NULL;
+  /* CPU_SET is undefined for numbers outside the set */
+  for(i=0;cpus != NULL && i<nthreads;i++)
+    if(cpus[i] < 0 || cpus[i] >= CPU_SETSIZE)
+      return NULL;
+
+  pool = malloc(sizeof(mkem_pool) + nthreads*sizeof(mkem_worker));
+  if(pool == NULL)
+    return NULL;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pthread_cond_init(&pool->fwdcond, NULL);
+  pool->generation = 0;
+  pool->pending = 0;
+  pool->shutdown = 0;
+  pool->pipelined = 0;
+  pool->nthreads = nthreads;
+
+  for(i=0;i<nthreads && !err;i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].id = i;
+
+    pthread_attr_init(&attr);
+    if(cpus != NULL) {
+      CPU_ZERO(&cpuset);
+      CPU_SET(cpus[i], &cpuset);
+      err = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+    }
+    if(!err)
+      err = pthread_create(&pool->workers[i].thread, &attr, worker_main, &pool->workers[i]);
+    pthread_attr_destroy(&attr);
+  }
+
+  if(err) {
+    /* Worker i-1 failed to start */
+    pool_stop(pool, i-1);
+    pthread_cond_destroy(&pool->fwdcond);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+/*************************************************
+* Name:        crypto_mkem_pool_free
+*
+* Description: Stops all workers and frees a pool
+*
+* Arguments:   - mkem_pool *pool: pointer to the pool (may be NULL)
+**************************************************/
+void crypto_mkem_pool_free(mkem_pool *pool)
+{
+  if(pool == NULL)
+    return;
+
+  pool_stop(pool, pool->nthreads);
+  pthread_cond_destroy(&pool->fwdcond);
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->start);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_pool
+*
+* Description: Same as crypto_mkem_enc, but the second ciphertext
+*              components are computed by the workers of a pool.
+*              The output is identical to the one of crypto_mkem_enc
+*              for the same system randomness.
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *c2: pointer to output second ciphertext components
+*                (an array of num_key pointers, each to an allocated array of MKYBER_C2BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*              - size_t num_keys: input batch size
+*              - uint8_t **pk: array of num_keys pointers to public keys,
+*                each pointing to an array of MKYBER_PUBLICKEYBYTES bytes
+*              - mkem_pool *pool: pointer to the pool of workers
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_pool(uint8_t *c1,
+                         uint8_t **c2s,
+                         uint8_t *ss,
+                         const uint8_t *seed,
+                         size_t num_keys,
+                         uint8_t *const* pk,
+                         mkem_pool *pool)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+
+  randombytes(msg, KYBER_SYMBYTES);
+  /* Don't release system RNG output */
+  hash_h(msg, msg, KYBER_SYMBYTES);
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, msg, KYBER_SYMBYTES);
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  pool_run(pool, c2s, msg, &fwd, num_keys, pk);
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_pipelined
+*
+* Description: Same as crypto_mkem_enc_pool, but with lower latency: the
+*              workers start before the first ciphertext component is
+*              computed by the calling thread. Each of them unpacks its
+*              first four public keys and derives their coins in the
+*              meantime and continues as soon as the forwarded information
+*              is available. The output is identical to the one of
+*              crypto_mkem_enc for the same system randomness.
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *c2: pointer to output second ciphertext components
+*                (an array of num_key pointers, each to an allocated array of MKYBER_C2BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*              - size_t num_keys: input batch size
+*              - uint8_t **pk: array of num_keys pointers to public keys,
+*                each pointing to an array of MKYBER_PUBLICKEYBYTES bytes
+*              - mkem_pool *pool: pointer to the pool of workers
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_pipelined(uint8_t *c1,
+                              uint8_t **c2s,
+                              uint8_t *ss,
+                              const uint8_t *seed,
+                              size_t num_keys,
+                              uint8_t *const* pk,
+                              mkem_pool *pool)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+
+  randombytes(msg, KYBER_SYMBYTES);
+  /* Don't release system RNG output */
+  hash_h(msg, msg, KYBER_SYMBYTES);
+
+  /* The recipient-dependent precomputation only needs msg */
+  pool_start(pool, c2s, msg, &fwd, num_keys, pk, 1);
+
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, msg, KYBER_SYMBYTES);
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  pool_publish_fwd(pool);
+  pool_wait(pool);
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_c2_pool
+*
+* Description: Generates the second ciphertext components of the split
+*              API for a batch of public keys using the workers of a pool;
+*              equivalent to calling crypto_mkem_enc_c2_fwd for every key
+*
+* Arguments:   - uint8_t *c2: pointer to output second ciphertext components
+*                (an array of num_key pointers, each to an allocated array of MKYBER_C2BYTES bytes)
+*              - size_t num_keys: input batch size
+*              - uint8_t **pk: array of num_keys pointers to public keys,
+*                each pointing to an array of MKYBER_PUBLICKEYBYTES bytes
+*              - const uint8_t *r: pointer to input random coins that were
+*                used for crypto_mkem_enc_c1_fwd (of length KYBER_SYMBYTES)
+*              - const mkem_fwd *fwd: pointer to (secret) information forwarded
+*                by crypto_mkem_enc_c1_fwd
+*              - mkem_pool *pool: pointer to the pool of workers
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_enc_c2_pool(uint8_t **c2s,
+                            size_t num_keys,
+                            uint8_t *const* pk,
+                            const uint8_t *r,
+                            const mkem_fwd *fwd,
+                            mkem_pool *pool)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+
+  /* Don't release system RNG output */
+  hash_h(msg, r, KYBER_SYMBYTES);
+
+  pool_run(pool, c2s, msg, fwd, num_keys, pk);
+  return 0;
+}
+
+/*************************************************
+* Name:        stream_compute
+*
+* Description: Computes one batch of second ciphertext components for
+*              crypto_mkem_enc_stream; with a pool, the batch is only
+*              started and pool_wait has to be called before it is used
+**************************************************/
+static void stream_compute(mkem_pool *pool,
+                           uint8_t **c2s,
+                           const uint8_t msg[KYBER_SYMBYTES],
+                           const mkem_fwd *fwd,
+                           size_t num_keys,
+                           uint8_t *const* pk)
+{
+  if(pool != NULL)
+    pool_start(pool, c2s, msg, fwd, num_keys, pk, 0);
+  else
+    mkem_enc_c2_batch(c2s, msg, fwd, num_keys, pk);
+}
+
+/*************************************************
+* Name:        crypto_mkem_enc_stream
+*
+* Description: Same as crypto_mkem_enc, but hands the ciphertexts to a sink
+*              as they are computed: first c1, then the second ciphertext
+*              components in batches of at most batch recipients. With a
+*              pool, its workers compute the next batch while the calling
+*              thread runs the sink on the current one; at most two
+*              batches are in flight, so a slow sink slows down the
+*              encapsulation instead of letting output pile up. Without a
+*              pool, the batches are computed by the calling thread
+*              between the calls of the sink.
+*
+* Arguments:   - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*              - size_t num_keys: input batch size
+*              - uint8_t **pk: array of num_keys pointers to public keys,
+*                each pointing to an array of MKYBER_PUBLICKEYBYTES bytes
+*              - size_t batch: maximal number of second ciphertext
+*                components per call of the sink (at least 1; larger
+*                values than num_keys are treated as num_keys)
+*              - const mkem_sink *sink: pointer to the receiver of the output
+*              - mkem_pool *pool: pointer to a pool of workers, or NULL
+*
+* Returns 0 on success, -1 if batch is 0, memory allocation failed, or
+* the sink aborted; on failure, ss is zeroed
+**************************************************/
+int crypto_mkem_enc_stream(uint8_t *ss,
+                           const uint8_t *seed,
+                           size_t num_keys,
+                           uint8_t *const* pk,
+                           size_t batch,
+                           const mkem_sink *sink,
+                           mkem_pool *pool)
+{
+  uint8_t msg[KYBER_SYMBYTES];
+  uint8_t c1[MKYBER_C1BYTES];
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+  /* Two buffers of batch components, used alternately */
+  uint8_t *buf, **c2s;
+  size_t i, j, n, cur;
+  int ret = 0;
+
+  if(batch == 0)
+    return -1;
+  /* Buffers never need to hold more than all recipients */
+  if(batch > num_keys)
+    batch = num_keys;
+  if(batch > SIZE_MAX/(2*MKYBER_C2BYTES))
+    return -1;
+
+  randombytes(msg, KYBER_SYMBYTES);
+  /* Don't release system RNG output */
+  hash_h(msg, msg, KYBER_SYMBYTES);
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, msg, KYBER_SYMBYTES);
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &fwd, &ctx, coins);
+
+  if(sink->c1(sink->arg, c1)) {
+    memset(ss, 0, KYBER_SSBYTES);
+    return -1;
+  }
+  if(num_keys == 0)
+    return 0;
+
+  buf = malloc(2*batch*MKYBER_C2BYTES);
+  c2s = malloc(2*batch*sizeof(uint8_t *));
+  if(buf == NULL || c2s == NULL) {
+    free(buf);
+    free(c2s);
+    memset(ss, 0, KYBER_SSBYTES);
+    return -1;
+  }
+  for(j=0;j<2*batch;j++)
+    c2s[j] = buf+j*MKYBER_C2BYTES;
+
+  cur = 0;
+  n = (num_keys < batch) ? num_keys : batch;
+  stream_compute(pool, c2s, msg, &fwd, n, pk);
+
+  for(i=0;i<num_keys;i+=n)
+  {
+    n = (num_keys-i < batch) ? num_keys-i : batch;
+    if(pool != NULL) {
+      pool_wait(pool);
+      /* Overlap the next batch with the sink */
+      if(i+n < num_keys)
+        stream_compute(pool, c2s+(cur^1)*batch, msg, &fwd,
+                       (num_keys-i-n < batch) ? num_keys-i-n : batch, pk+i+n);
+    }
+
+    ret = sink->c2(sink->arg, i, buf+cur*batch*MKYBER_C2BYTES, n);
+    if(ret) {
+      if(pool != NULL && i+n < num_keys)
+        pool_wait(pool);
+      ret = -1;
+      break;
+    }
+
+    if(pool == NULL && i+n < num_keys)
+      stream_compute(pool, c2s+(cur^1)*batch, msg, &fwd,
+                     (num_keys-i-n < batch) ? num_keys-i-n : batch, pk+i+n);
+    cur ^= 1;
+  }
+
+  free(buf);
+  free(c2s);
+  if(ret)
+    memset(ss, 0, KYBER_SSBYTES);
+  return ret;
+}
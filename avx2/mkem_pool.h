@@ -0,0 +1,65 @@
+#ifndef KYBER_MKEM_POOL_H
+#define KYBER_MKEM_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "params.h"
+#include "mkem.h"
+
+/* Persistent pool of worker threads for encapsulation to large groups;
+ * treat as opaque. A pool serves one encapsulation call at a time. */
+typedef struct mkem_pool mkem_pool;
+
+/* Receiver of the output of crypto_mkem_enc_stream: c1 is called once
+ * with the first ciphertext component, then c2 is called in recipient
+ * order with count consecutive second ciphertext components (of
+ * MKYBER_C2BYTES bytes each) for the recipients index..index+count-1.
+ * A nonzero return value aborts the encapsulation. */
+typedef struct {
+  int (*c1)(void *arg, const uint8_t *c1);
+  int (*c2)(void *arg, size_t index, const uint8_t *c2s, size_t count);
+  void *arg;
+} mkem_sink;
+
+mkem_pool *crypto_mkem_pool_new(unsigned int nthreads,
+                                const int *cpus);
+
+
+void crypto_mkem_pool_free(mkem_pool *pool);
+
+
+int crypto_mkem_enc_pool(uint8_t *c1,
+                         uint8_t **c2s,
+                         uint8_t *ss,
+                         const uint8_t *seed,
+                         size_t num_keys,
+                         uint8_t *const* pk,
+                         mkem_pool *pool);
+
+
+int crypto_mkem_enc_pipelined(uint8_t *c1,
+                              uint8_t **c2s,
+                              uint8_t *ss,
+                              const uint8_t *seed,
+                              size_t num_keys,
+                              uint8_t *const* pk,
+                              mkem_pool *pool);
+
+
+int crypto_mkem_enc_c2_pool(uint8_t **c2s,
+                            size_t num_keys,
+                            uint8_t *const* pk,
+                            const uint8_t *r,
+                            const mkem_fwd *fwd,
+                            mkem_pool *pool);
+
+
+int crypto_mkem_enc_stream(uint8_t *ss,
+                           const uint8_t *seed,
+                           size_t num_keys,
+                           uint8_t *const* pk,
+                           size_t batch,
+                           const mkem_sink *sink,
+                           mkem_pool *pool);
+
+#endif
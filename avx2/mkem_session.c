@@ -0,0 +1,192 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "params.h"
+#include "mkem.h"
+#include "mkem_session.h"
+#include "mkem_internal.h"
+#include "indcpa.h"
+#include "symmetric.h"
+#include "randombytes.h"
+
+/* Bytes of stack overwritten after every session operation; more than
+ * the stack used by indcpa_enc_c1_fwd and mkem_enc_c2_batch together
+ * with their callees (about 46 KiB for KYBER_K=4). test_session in
+ * test_mkyber.c fails if the message is left beyond this depth. */
+#define SESSION_SCRUBBYTES 65536
+
+struct mkem_session {
+  mkem_fwd fwd;
+  uint8_t msg[KYBER_SYMBYTES];
+};
+
+/*************************************************
+* Name:        session_bytes
+*
+* Description: Returns the size of the mapping holding a session,
+*              rounded up to whole pages
+**************************************************/
+static size_t session_bytes(void)
+{
+  size_t pagesize = sysconf(_SC_PAGESIZE);
+
+  return (sizeof(mkem_session)+pagesize-1) & ~(pagesize-1);
+}
+
+/*************************************************
+* Name:        session_wipe
+*
+* Description: Overwrites memory with zeros through a volatile pointer,
+*              so that the stores are not removed as dead
+**************************************************/
+static void session_wipe(void *p, size_t len)
+{
+  volatile uint8_t *v = p;
+
+  while(len--)
+    *v++ = 0;
+}
+
+/*************************************************
+* Name:        session_scrub_stack
+*
+* Description: Overwrites the stack below the frame of the caller, where
+*              the functions it called left their temporaries: the
+*              message and the error vectors of c1 (which together with
+*              c1 reveal the forwarded noise vectors). The barrier keeps
+*              the compiler from dropping the stores to the dead buffer.
+**************************************************/
+static __attribute__((noinline)) void session_scrub_stack(void)
+{
+  uint8_t buf[SESSION_SCRUBBYTES];
+
+  memset(buf, 0, sizeof(buf));
+  __asm__ volatile ("" : : "r" (buf) : "memory");
+}
+
+/*************************************************
+* Name:        crypto_mkem_session_new
+*
+* Description: Starts a group session: computes the first ciphertext
+*              component and the shared key like crypto_mkem_enc, and
+*              keeps the message and the forwarded information in pages
+*              that are locked into memory and excluded from core dumps
+*
+* Arguments:   - uint8_t *c1: pointer to output first ciphertext component
+*                (an already allocated array of MKYBER_C1BYTES bytes)
+*              - uint8_t *ss: pointer to output shared key
+*                (an already allocated array of KYBER_SSBYTES bytes)
+*              - const uint8_t *seed: pointer to the input public seed, which
+*                needs to be of length KYBER_SYMBYTES and generated beforehand
+*
+* Returns pointer to the session, or NULL if the memory cannot be
+* allocated or locked (see RLIMIT_MEMLOCK)
+**************************************************/
+mkem_session *crypto_mkem_session_new(uint8_t *c1,
+                                      uint8_t *ss,
+                                      const uint8_t *seed)
+{
+  mkem_session *session;
+  mkem_seedctx ctx;
+  /* Will contain key, coins */
+  uint8_t coins[KYBER_SYMBYTES];
+  size_t len = session_bytes();
+
+  session = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(session == MAP_FAILED)
+    return NULL;
+  if(mlock(session, len)) {
+    munmap(session, len);
+    return NULL;
+  }
+  madvise(session, len, MADV_DONTDUMP);
+
+  randombytes(session->msg, KYBER_SYMBYTES);
+  /* Don't release system RNG output */
+  hash_h(session->msg, session->msg, KYBER_SYMBYTES);
+  /* Hash msg to coins common to all ciphertexts */
+  hash_h(coins, session->msg, KYBER_SYMBYTES);
+  /* Compute shared key as KDF(msg) */
+  kdf(ss, session->msg, KYBER_SYMBYTES);
+
+  indcpa_seedctx_init(&ctx, seed);
+  indcpa_enc_c1_fwd(c1, &session->fwd, &ctx, coins);
+  session_wipe(coins, sizeof(coins));
+  session_scrub_stack();
+  return session;
+}
+
+/*************************************************
+* Name:        crypto_mkem_session_free
+*
+* Description: Erases and frees a session; recipients cannot be added
+*              to its shared key afterwards
+*
+* Arguments:   - mkem_session *session: pointer to the session (may be NULL)
+**************************************************/
+void crypto_mkem_session_free(mkem_session *session)
+{
+  size_t len = session_bytes();
+
+  if(session == NULL)
+    return;
+
+  session_wipe(session, sizeof(mkem_session));
+  munlock(session, len);
+  munmap(session, len);
+}
+
+/*************************************************
+* Name:        crypto_mkem_session_add
+*
+* Description: Generates the second ciphertext component for a new
+*              recipient of a session; the recipient decapsulates the
+*              shared key of the session from it and the first ciphertext
+*              component output by crypto_mkem_session_new
+*
+* Arguments:   - const mkem_session *session: pointer to the session
+*              - uint8_t *c2: pointer to output second ciphertext component
+*                (an already allocated array of MKYBER_C2BYTES bytes)
+*              - const uint8_t *pk: pointer to input public key
+*                (an array of MKYBER_PUBLICKEYBYTES bytes)
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_session_add(const mkem_session *session,
+                            uint8_t *c2,
+                            const uint8_t *pk)
+{
+  uint8_t *pkp = (uint8_t *)pk;
+
+  mkem_enc_c2_batch(&c2, session->msg, &session->fwd, 1, &pkp);
+  session_scrub_stack();
+  return 0;
+}
+
+/*************************************************
+* Name:        crypto_mkem_session_add_batch
+*
+* Description: Same as crypto_mkem_session_add for num_keys recipients,
+*              four (or eight) at a time
+*
+* Arguments:   - const mkem_session *session: pointer to the session
+*              - uint8_t **c2s: array of num_keys pointers to output second
+*                ciphertext components (each of MKYBER_C2BYTES bytes)
+*              - size_t num_keys: number of new recipients
+*              - uint8_t **pk: array of num_keys pointers to public keys,
+*                each pointing to an array of MKYBER_PUBLICKEYBYTES bytes
+*
+* Returns 0 (success)
+**************************************************/
+int crypto_mkem_session_add_batch(const mkem_session *session,
+                                  uint8_t **c2s,
+                                  size_t num_keys,
+                                  uint8_t *const* pk)
+{
+  mkem_enc_c2_batch(c2s, session->msg, &session->fwd, num_keys, pk);
+  session_scrub_stack();
+  return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef KYBER_MKEM_SESSION_H
+#define KYBER_MKEM_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "params.h"
+#include "mkem.h"
+
+/* Encapsulation state of one group shared key, kept in locked memory
+ * so that recipients can be added later; treat as opaque */
+typedef struct mkem_session mkem_session;
+
+mkem_session *crypto_mkem_session_new(uint8_t *c1,
+                                      uint8_t *ss,
+                                      const uint8_t *seed);
+
+
+void crypto_mkem_session_free(mkem_session *session);
+
+
+int crypto_mkem_session_add(const mkem_session *session,
+                            uint8_t *c2,
+                            const uint8_t *pk);
+
+
+int crypto_mkem_session_add_batch(const mkem_session *session,
+                                  uint8_t **c2s,
+                                  size_t num_keys,
+                                  uint8_t *const* pk);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef NTT_H
 #define NTT_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <immintrin.h>
 
@@ -8,6 +9,10 @@
 void ntt_avx(__m256i *r, const __m256i *qdata);
 #define invntt_avx KYBER_NAMESPACE(invntt_avx)
 void invntt_avx(__m256i *r, const __m256i *qdata);
+#define ntt_batch_avx KYBER_NAMESPACE(ntt_batch_avx)
+void ntt_batch_avx(__m256i *r, const __m256i *qdata, size_t n);
+#define invntt_batch_avx KYBER_NAMESPACE(invntt_batch_avx)
+void invntt_batch_avx(__m256i *r, const __m256i *qdata, size_t n);
 
 #define nttpack_avx KYBER_NAMESPACE(nttpack_avx)
 void nttpack_avx(__m256i *r, const __m256i *qdata);
@@ -19,6 +24,36 @@ void basemul_avx(__m256i *r,
                  const __m256i *a,
                  const __m256i *b,
                  const __m256i *qdata);
+#define basemul_acc_avx KYBER_NAMESPACE(basemul_acc_avx)
+void basemul_acc_avx(__m256i *r,
+                     const __m256i *a,
+                     const __m256i *b,
+                     const __m256i *qdata);
+
+#define basemul_acc2_avx KYBER_NAMESPACE(basemul_acc2_avx)
+void basemul_acc2_avx(__m256i *r0,
+                      __m256i *r1,
+                      const __m256i *a,
+                      const __m256i *b0,
+                      const __m256i *b1,
+                      const __m256i *qdata);
+
+#define basemul_prepare_avx KYBER_NAMESPACE(basemul_prepare_avx)
+void basemul_prepare_avx(__m256i *r,
+                         const __m256i *b,
+                         const __m256i *qdata);
+#define basemul_accprep_avx KYBER_NAMESPACE(basemul_accprep_avx)
+void basemul_accprep_avx(__m256i *r,
+                         const __m256i *a,
+                         const __m256i *b,
+                         const __m256i *qdata);
+#define basemul_accprep2_avx KYBER_NAMESPACE(basemul_accprep2_avx)
+void basemul_accprep2_avx(__m256i *r0,
+                          __m256i *r1,
+                          const __m256i *a0,
+                          const __m256i *a1,
+                          const __m256i *b,
+                          const __m256i *qdata);
 
 #define ntttobytes_avx KYBER_NAMESPACE(ntttobytes_avx)
 void ntttobytes_avx(uint8_t *r, const __m256i *a, const __m256i *qdata);
@@ -47,6 +47,11 @@
 
 #define MKYBER_FWDBYTES (2*KYBER_POLYVECBYTES)
 
+/* Randomness drawn by indcpa_mkeypair: noise seed plus flip byte, fake pk seed */
+#define MKYBER_INDCPA_KEYPAIRCOINBYTES (2*KYBER_SYMBYTES+1)
+/* Additionally z for implicit rejection */
+#define MKYBER_KEYPAIRCOINBYTES (MKYBER_INDCPA_KEYPAIRCOINBYTES+KYBER_SYMBYTES)
+
 #define MKYBER_PUBLICKEYBYTES  (MKYBER_INDCPA_PUBLICKEYBYTES)
 #define MKYBER_SECRETKEYBYTES  (MKYBER_INDCPA_SECRETKEYBYTES + MKYBER_INDCPA_PUBLICKEYBYTES + 2*KYBER_SYMBYTES)
 #define MKYBER_C1BYTES         (2*KYBER_POLYVECCOMPRESSEDBYTES)
@@ -0,0 +1,161 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#include "perfcounters.h"
+
+const char *const perfcounters_names[PERF_NEVENTS] = {
+  "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses", "raw"
+};
+
+#ifdef __linux__
+/*************************************************
+* Name:        open_event
+*
+* Description: Opens one running user-space counter of the calling thread
+*              in the group of leader (or as a new group if leader is -1)
+*
+* Returns file descriptor, or -1 with errno set
+**************************************************/
+static int open_event(uint32_t type, uint64_t config, int leader)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+#endif
+
+/*************************************************
+* Name:        perfcounters_open
+*
+* Description: Opens the counters as one group led by the cycle counter;
+*              events the CPU or kernel does not support are left out.
+*              When the leader cannot be opened (no PMU, as in most
+*              containers and virtual machines, perf_event_paranoid, seccomp
+*              or a non-Linux system), all counters are unavailable and
+*              perfcounters_stop reports zeros
+*
+* Arguments:   - perfcounters *pc: pointer to output counters
+*
+* Returns number of events opened; prints the reason to stderr if 0
+**************************************************/
+int perfcounters_open(perfcounters *pc)
+{
+  int i, n = 0;
+#ifdef __linux__
+  const char *raw = getenv("MKYBER_PERF_RAW");
+  static const uint64_t l1dmiss = PERF_COUNT_HW_CACHE_L1D
+    | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  static const uint64_t llcmiss = PERF_COUNT_HW_CACHE_LL
+    | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+#endif
+
+  for(i=0;i<PERF_NEVENTS;i++)
+    pc->fd[i] = -1;
+  pc->leader = -1;
+
+#ifdef __linux__
+  pc->leader = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  if(pc->leader == -1) {
+    fprintf(stderr, "perf counters unavailable (%s), reporting time stamp counter only\n",
+            strerror(errno));
+    return 0;
+  }
+  pc->fd[PERF_CYCLES] = pc->leader;
+  pc->fd[PERF_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, pc->leader);
+  pc->fd[PERF_BRANCHMISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, pc->leader);
+  pc->fd[PERF_L1DMISSES] = open_event(PERF_TYPE_HW_CACHE, l1dmiss, pc->leader);
+  pc->fd[PERF_LLCMISSES] = open_event(PERF_TYPE_HW_CACHE, llcmiss, pc->leader);
+  if(raw != NULL)
+    pc->fd[PERF_RAW] = open_event(PERF_TYPE_RAW, strtoull(raw, NULL, 16), pc->leader);
+
+  for(i=0;i<PERF_NEVENTS;i++)
+    n += (pc->fd[i] != -1);
+#else
+  fprintf(stderr, "perf counters unavailable (not Linux), reporting time stamp counter only\n");
+#endif
+  return n;
+}
+
+/*************************************************
+* Name:        perfcounters_close
+*
+* Description: Closes all counters opened by perfcounters_open
+*
+* Arguments:   - perfcounters *pc: pointer to counters
+**************************************************/
+void perfcounters_close(perfcounters *pc)
+{
+  int i;
+
+  for(i=PERF_NEVENTS-1;i>=0;i--) {
+    if(pc->fd[i] != -1)
+      close(pc->fd[i]);
+    pc->fd[i] = -1;
+  }
+  pc->leader = -1;
+}
+
+/*************************************************
+* Name:        read_counters
+*
+* Description: Reads all counters; the counters keep running, so that
+*              measurements are differences of two reads
+*
+* Arguments:   - const perfcounters *pc: pointer to counters
+*              - uint64_t *val: pointer to output counts, zero for
+*                events that are unavailable
+**************************************************/
+static void read_counters(const perfcounters *pc, uint64_t val[PERF_NEVENTS])
+{
+  int i;
+
+  for(i=0;i<PERF_NEVENTS;i++) {
+    val[i] = 0;
+    if(pc->fd[i] != -1 && read(pc->fd[i], &val[i], sizeof(uint64_t)) != sizeof(uint64_t))
+      val[i] = 0;
+  }
+}
+
+/*************************************************
+* Name:        perfcounters_start
+*
+* Description: Starts a measurement
+*
+* Arguments:   - perfcounters *pc: pointer to counters
+**************************************************/
+void perfcounters_start(perfcounters *pc)
+{
+  read_counters(pc, pc->start);
+}
+
+/*************************************************
+* Name:        perfcounters_stop
+*
+* Description: Ends a measurement started by perfcounters_start
+*
+* Arguments:   - const perfcounters *pc: pointer to counters
+*              - uint64_t *val: pointer to output event counts since
+*                perfcounters_start, zero for events that are unavailable
+**************************************************/
+void perfcounters_stop(const perfcounters *pc, uint64_t val[PERF_NEVENTS])
+{
+  int i;
+
+  read_counters(pc, val);
+  for(i=0;i<PERF_NEVENTS;i++)
+    val[i] -= pc->start[i];
+}
@@ -0,0 +1,34 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdint.h>
+
+/* Hardware event counters of the calling thread, read through Linux
+ * perf_event_open; used by the benchmarks only */
+
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_BRANCHMISSES 2
+#define PERF_L1DMISSES 3
+#define PERF_LLCMISSES 4
+/* Model-specific event given as hex in MKYBER_PERF_RAW,
+ * e.g. the retired uops event of the CPU */
+#define PERF_RAW 5
+#define PERF_NEVENTS 6
+
+extern const char *const perfcounters_names[PERF_NEVENTS];
+
+/* fd[i] is -1 for events that could not be opened;
+ * start holds the counts read by perfcounters_start */
+typedef struct {
+  int fd[PERF_NEVENTS];
+  int leader;
+  uint64_t start[PERF_NEVENTS];
+} perfcounters;
+
+int perfcounters_open(perfcounters *pc);
+void perfcounters_close(perfcounters *pc);
+void perfcounters_start(perfcounters *pc);
+void perfcounters_stop(const perfcounters *pc, uint64_t val[PERF_NEVENTS]);
+
+#endif
@@ -503,6 +503,89 @@ void poly_getnoise_eta1122_4x(poly *r0,
 }
 #endif
 
+/*************************************************
+* Name:        poly_getnoise_eta2_4x_multiseed
+*
+* Description: Four-lane variant of poly_getnoise_eta2 in which every
+*              lane has its own seed (e.g., one per recipient)
+*
+* Arguments:   - poly *r0-r3: pointers to output polynomials
+*              - const uint8_t *seed0-seed3: pointers to input seeds
+*                                     (each of length KYBER_SYMBYTES bytes)
+*              - uint8_t nonce0-nonce3: one-byte input nonces
+**************************************************/
+void poly_getnoise_eta2_4x_multiseed(poly *r0,
+                                     poly *r1,
+                                     poly *r2,
+                                     poly *r3,
+                                     const uint8_t seed0[KYBER_SYMBYTES],
+                                     const uint8_t seed1[KYBER_SYMBYTES],
+                                     const uint8_t seed2[KYBER_SYMBYTES],
+                                     const uint8_t seed3[KYBER_SYMBYTES],
+                                     uint8_t nonce0,
+                                     uint8_t nonce1,
+                                     uint8_t nonce2,
+                                     uint8_t nonce3)
+{
+  ALIGNED_UINT8(SHAKE256_RATE) buf[4];
+  keccakx4_state state;
+
+  _mm256_store_si256(buf[0].vec, _mm256_loadu_si256((__m256i *)seed0));
+  _mm256_store_si256(buf[1].vec, _mm256_loadu_si256((__m256i *)seed1));
+  _mm256_store_si256(buf[2].vec, _mm256_loadu_si256((__m256i *)seed2));
+  _mm256_store_si256(buf[3].vec, _mm256_loadu_si256((__m256i *)seed3));
+
+  buf[0].coeffs[32] = nonce0;
+  buf[1].coeffs[32] = nonce1;
+  buf[2].coeffs[32] = nonce2;
+  buf[3].coeffs[32] = nonce3;
+
+  shake256x4_absorb_once(&state, buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, 33);
+  shake256x4_squeezeblocks(buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, 1, &state);
+
+  poly_cbd_eta2(r0, buf[0].vec);
+  poly_cbd_eta2(r1, buf[1].vec);
+  poly_cbd_eta2(r2, buf[2].vec);
+  poly_cbd_eta2(r3, buf[3].vec);
+}
+
+#ifdef KYBER_KECCAK8X
+/*************************************************
+* Name:        poly_getnoise_eta2_8x
+*
+* Description: Eight-lane variant of poly_getnoise_eta2 running on the
+*              AVX-512 Keccak; every lane has its own seed and nonce
+*
+* Arguments:   - poly **r: array of 8 pointers to output polynomials
+*              - const uint8_t **seed: array of 8 pointers to input seeds
+*                                     (each of length KYBER_SYMBYTES bytes)
+*              - const uint8_t *nonce: array of 8 one-byte input nonces
+**************************************************/
+void poly_getnoise_eta2_8x(poly *const r[8],
+                           const uint8_t *const seed[8],
+                           const uint8_t nonce[8])
+{
+  unsigned int i;
+  ALIGNED_UINT8(SHAKE256_RATE) buf[8];
+  const uint8_t *in[8];
+  uint8_t *out[8];
+  keccakx8_state state;
+
+  for(i=0;i<8;i++) {
+    _mm256_store_si256(buf[i].vec, _mm256_loadu_si256((__m256i *)seed[i]));
+    buf[i].coeffs[32] = nonce[i];
+    in[i] = buf[i].coeffs;
+    out[i] = buf[i].coeffs;
+  }
+
+  shake256x8_absorb_once(&state, in, 33);
+  shake256x8_squeezeblocks(out, 1, &state);
+
+  for(i=0;i<8;i++)
+    poly_cbd_eta2(r[i], buf[i].vec);
+}
+#endif
+
 /*************************************************
 * Name:        poly_ntt
 *
@@ -538,6 +621,37 @@ void poly_invntt_tomont(poly *r)
   invntt_avx(r->vec, qdata.vec);
 }
 
+/*************************************************
+* Name:        poly_ntt_batch
+*
+* Description: Computes the forward NTT of n consecutive polynomials in
+*              place; same output as calling poly_ntt on each of them.
+*              Two polynomials are transformed per pass with interleaved
+*              levels and the modulus stays in a register across the batch.
+*
+* Arguments:   - poly *r: pointer to array of n in/output polynomials
+*              - size_t n: number of polynomials
+**************************************************/
+void poly_ntt_batch(poly *r, size_t n)
+{
+  ntt_batch_avx(r->vec, qdata.vec, n);
+}
+
+/*************************************************
+* Name:        poly_invntt_tomont_batch
+*
+* Description: Computes the inverse NTT of n consecutive polynomials in
+*              place; same output as calling poly_invntt_tomont on each
+*              of them, two polynomials per pass.
+*
+* Arguments:   - poly *r: pointer to array of n in/output polynomials
+*              - size_t n: number of polynomials
+**************************************************/
+void poly_invntt_tomont_batch(poly *r, size_t n)
+{
+  invntt_batch_avx(r->vec, qdata.vec, n);
+}
+
 void poly_nttunpack(poly *r)
 {
   nttunpack_avx(r->vec, qdata.vec);
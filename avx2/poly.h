@@ -1,9 +1,11 @@
 #ifndef POLY_H
 #define POLY_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "align.h"
 #include "params.h"
+#include "fips202x8.h"
 
 typedef ALIGNED_INT16(KYBER_N) poly;
 
@@ -63,11 +65,35 @@ void poly_getnoise_eta1122_4x(poly *r0,
                               uint8_t nonce3);
 #endif
 
+#define poly_getnoise_eta2_4x_multiseed KYBER_NAMESPACE(poly_getnoise_eta2_4x_multiseed)
+void poly_getnoise_eta2_4x_multiseed(poly *r0,
+                                     poly *r1,
+                                     poly *r2,
+                                     poly *r3,
+                                     const uint8_t seed0[KYBER_SYMBYTES],
+                                     const uint8_t seed1[KYBER_SYMBYTES],
+                                     const uint8_t seed2[KYBER_SYMBYTES],
+                                     const uint8_t seed3[KYBER_SYMBYTES],
+                                     uint8_t nonce0,
+                                     uint8_t nonce1,
+                                     uint8_t nonce2,
+                                     uint8_t nonce3);
+
+#ifdef KYBER_KECCAK8X
+#define poly_getnoise_eta2_8x KYBER_NAMESPACE(poly_getnoise_eta2_8x)
+void poly_getnoise_eta2_8x(poly *const r[8],
+                           const uint8_t *const seed[8],
+                           const uint8_t nonce[8]);
+#endif
 
 #define poly_ntt KYBER_NAMESPACE(poly_ntt)
 void poly_ntt(poly *r);
 #define poly_invntt_tomont KYBER_NAMESPACE(poly_invntt_tomont)
 void poly_invntt_tomont(poly *r);
+#define poly_ntt_batch KYBER_NAMESPACE(poly_ntt_batch)
+void poly_ntt_batch(poly *r, size_t n);
+#define poly_invntt_tomont_batch KYBER_NAMESPACE(poly_invntt_tomont_batch)
+void poly_invntt_tomont_batch(poly *r, size_t n);
 #define poly_nttunpack KYBER_NAMESPACE(poly_nttunpack)
 void poly_nttunpack(poly *r);
 #define poly_basemul_montgomery KYBER_NAMESPACE(poly_basemul_montgomery)
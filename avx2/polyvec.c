@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <immintrin.h>
+#include <stddef.h>
 #include <string.h>
 #include "params.h"
 #include "polyvec.h"
@@ -8,11 +9,12 @@
 #include "consts.h"
 
 #if (KYBER_POLYVECCOMPRESSEDBYTES == (KYBER_K * 320))
-static void poly_compress10(uint8_t r[320], const poly * restrict a)
+static void poly_compress10(uint8_t r[320], const poly * restrict a, const poly * restrict e)
 {
   unsigned int i;
   __m256i f0, f1, f2;
   __m128i t0, t1;
+  const __m256i q = _mm256_load_si256(&qdata.vec[_16XQ/16]);
   const __m256i v = _mm256_load_si256(&qdata.vec[_16XV/16]);
   const __m256i v8 = _mm256_slli_epi16(v,3);
   const __m256i off = _mm256_set1_epi16(15);
@@ -25,6 +27,14 @@ static void poly_compress10(uint8_t r[320], const poly * restrict a)
 
   for(i=0;i<KYBER_N/16;i++) {
     f0 = _mm256_load_si256(&a->vec[i]);
+    if(e != NULL) {
+      /* add e and Barrett-reduce as poly_reduce does */
+      f0 = _mm256_add_epi16(f0,_mm256_load_si256(&e->vec[i]));
+      f1 = _mm256_mulhi_epi16(f0,v);
+      f1 = _mm256_srai_epi16(f1,10);
+      f1 = _mm256_mullo_epi16(f1,q);
+      f0 = _mm256_sub_epi16(f0,f1);
+    }
     f1 = _mm256_mullo_epi16(f0,v8);
     f2 = _mm256_add_epi16(f0,off);
     f0 = _mm256_slli_epi16(f0,3);
@@ -72,11 +82,12 @@ static void poly_decompress10(poly * restrict r, const uint8_t a[320+12])
 }
 
 #elif (KYBER_POLYVECCOMPRESSEDBYTES == (KYBER_K * 352))
-static void poly_compress11(uint8_t r[352+2], const poly * restrict a)
+static void poly_compress11(uint8_t r[352+2], const poly * restrict a, const poly * restrict e)
 {
   unsigned int i;
   __m256i f0, f1, f2;
   __m128i t0, t1;
+  const __m256i q = _mm256_load_si256(&qdata.vec[_16XQ/16]);
   const __m256i v = _mm256_load_si256(&qdata.vec[_16XV/16]);
   const __m256i v8 = _mm256_slli_epi16(v,3);
   const __m256i off = _mm256_set1_epi16(36);
@@ -90,6 +101,14 @@ static void poly_compress11(uint8_t r[352+2], const poly * restrict a)
 
   for(i=0;i<KYBER_N/16;i++) {
     f0 = _mm256_load_si256(&a->vec[i]);
+    if(e != NULL) {
+      /* add e and Barrett-reduce as poly_reduce does */
+      f0 = _mm256_add_epi16(f0,_mm256_load_si256(&e->vec[i]));
+      f1 = _mm256_mulhi_epi16(f0,v);
+      f1 = _mm256_srai_epi16(f1,10);
+      f1 = _mm256_mullo_epi16(f1,q);
+      f0 = _mm256_sub_epi16(f0,f1);
+    }
     f1 = _mm256_mullo_epi16(f0,v8);
     f2 = _mm256_add_epi16(f0,off);
     f0 = _mm256_slli_epi16(f0,3);
@@ -160,11 +179,41 @@ void polyvec_compress(uint8_t r[KYBER_POLYVECCOMPRESSEDBYTES+2], const polyvec *
 
 #if (KYBER_POLYVECCOMPRESSEDBYTES == (KYBER_K * 320))
   for(i=0;i<KYBER_K;i++)
-    poly_compress10(&r[320*i],&a->vec[i]);
+    poly_compress10(&r[320*i],&a->vec[i],NULL);
 #elif (KYBER_POLYVECCOMPRESSEDBYTES == (KYBER_K * 352))
   for(i=0;i<KYBER_K;i++)
-    poly_compress11(&r[352*i],&a->vec[i]);
+    poly_compress11(&r[352*i],&a->vec[i],NULL);
+#endif
+}
+
+/*************************************************
+* Name:        polyvec_invntt_add_compress
+*
+* Description: Computes compress(reduce(invntt(a) + e)); the addition and
+*              reduction are done in registers while compressing. Same
+*              output as polyvec_invntt_tomont, polyvec_add, polyvec_reduce
+*              and polyvec_compress.
+*
+* Arguments:   - uint8_t *r: pointer to output byte array
+*                            (needs space for KYBER_POLYVECCOMPRESSEDBYTES)
+*              - polyvec *a: pointer to input vector of polynomials in NTT
+*                            domain (overwritten)
+*              - const polyvec *e: pointer to vector of polynomials to add
+**************************************************/
+void polyvec_invntt_add_compress(uint8_t r[KYBER_POLYVECCOMPRESSEDBYTES+2],
+                                 polyvec *a,
+                                 const polyvec *e)
+{
+  unsigned int i;
+
+  poly_invntt_tomont_batch(a->vec, KYBER_K);
+  for(i=0;i<KYBER_K;i++) {
+#if (KYBER_POLYVECCOMPRESSEDBYTES == (KYBER_K * 320))
+    poly_compress10(&r[320*i],&a->vec[i],&e->vec[i]);
+#elif (KYBER_POLYVECCOMPRESSEDBYTES == (KYBER_K * 352))
+    poly_compress11(&r[352*i],&a->vec[i],&e->vec[i]);
 #endif
+  }
 }
 
 /*************************************************
@@ -232,9 +281,7 @@ void polyvec_frombytes(polyvec *r, const uint8_t a[KYBER_POLYVECBYTES])
 **************************************************/
 void polyvec_ntt(polyvec *r)
 {
-  unsigned int i;
-  for(i=0;i<KYBER_K;i++)
-    poly_ntt(&r->vec[i]);
+  poly_ntt_batch(r->vec, KYBER_K);
 }
 
 /*************************************************
@@ -247,16 +294,18 @@ void polyvec_ntt(polyvec *r)
 **************************************************/
 void polyvec_invntt_tomont(polyvec *r)
 {
-  unsigned int i;
-  for(i=0;i<KYBER_K;i++)
-    poly_invntt_tomont(&r->vec[i]);
+  poly_invntt_tomont_batch(r->vec, KYBER_K);
 }
 
 /*************************************************
 * Name:        polyvec_basemul_acc_montgomery
 *
 * Description: Multiply elements in a and b in NTT domain, accumulate into r,
-*              and multiply by 2^-16.
+*              and multiply by 2^-16. The products are accumulated as 32-bit
+*              sums in registers and reduced once per output coefficient.
+*              One of the input vectors needs to have coefficients bounded
+*              by 4096, the other vector can have arbitrary coefficients.
+*              Output coefficients are bounded by 16384.
 *
 * Arguments: - poly *r: pointer to output polynomial
 *            - const polyvec *a: pointer to first input vector of polynomials
@@ -264,14 +313,85 @@ void polyvec_invntt_tomont(polyvec *r)
 **************************************************/
 void polyvec_basemul_acc_montgomery(poly *r, const polyvec *a, const polyvec *b)
 {
-  unsigned int i;
-  poly tmp;
+  basemul_acc_avx(r->vec, a->vec[0].vec, b->vec[0].vec, qdata.vec);
+}
 
-  poly_basemul_montgomery(r,&a->vec[0],&b->vec[0]);
-  for(i=1;i<KYBER_K;i++) {
-    poly_basemul_montgomery(&tmp,&a->vec[i],&b->vec[i]);
-    poly_add(r,r,&tmp);
-  }
+/*************************************************
+* Name:        polyvec_basemul_acc_montgomery_2x
+*
+* Description: Computes the inner products of a with b0 and with b1 in NTT
+*              domain, multiplied by 2^-16, loading every polynomial of a
+*              only once. Same output as two calls to
+*              polyvec_basemul_acc_montgomery; a needs to have coefficients
+*              bounded by 4096.
+*
+* Arguments: - poly *r0: pointer to output polynomial a*b0
+*            - poly *r1: pointer to output polynomial a*b1
+*            - const polyvec *a: pointer to shared input vector of polynomials
+*            - const polyvec *b0, *b1: pointers to input vectors of polynomials
+**************************************************/
+void polyvec_basemul_acc_montgomery_2x(poly *r0,
+                                       poly *r1,
+                                       const polyvec *a,
+                                       const polyvec *b0,
+                                       const polyvec *b1)
+{
+  basemul_acc2_avx(r0->vec, r1->vec, a->vec[0].vec, b0->vec[0].vec, b1->vec[0].vec, qdata.vec);
+}
+
+/*************************************************
+* Name:        polyvec_basemul_prepare
+*
+* Description: Prepares a vector of polynomials in NTT domain as operand
+*              of polyvec_basemul_acc_montgomery_prepared(_2x)
+*
+* Arguments: - polyvec_prepared *r: pointer to output prepared vector
+*            - const polyvec *b: pointer to input vector of polynomials
+*                                (coefficients bounded by 4096)
+**************************************************/
+void polyvec_basemul_prepare(polyvec_prepared *r, const polyvec *b)
+{
+  basemul_prepare_avx(r->vec, b->vec[0].vec, qdata.vec);
+}
+
+/*************************************************
+* Name:        polyvec_basemul_acc_montgomery_prepared
+*
+* Description: Same as polyvec_basemul_acc_montgomery, but with the
+*              second input vector prepared by polyvec_basemul_prepare
+*
+* Arguments: - poly *r: pointer to output polynomial
+*            - const polyvec *a: pointer to input vector of polynomials
+*            - const polyvec_prepared *b: pointer to prepared input vector
+**************************************************/
+void polyvec_basemul_acc_montgomery_prepared(poly *r,
+                                             const polyvec *a,
+                                             const polyvec_prepared *b)
+{
+  basemul_accprep_avx(r->vec, a->vec[0].vec, b->vec, qdata.vec);
+}
+
+/*************************************************
+* Name:        polyvec_basemul_acc_montgomery_prepared_2x
+*
+* Description: Computes the inner products of a0 and of a1 with the
+*              prepared vector b in NTT domain, multiplied by 2^-16; the
+*              operands of b are shared by both products. Same output as
+*              polyvec_basemul_acc_montgomery with the unprepared vector.
+*
+* Arguments: - poly *r0: pointer to output polynomial a0*b
+*            - poly *r1: pointer to output polynomial a1*b
+*            - const polyvec *a0, *a1: pointers to input vectors of
+*                                      polynomials
+*            - const polyvec_prepared *b: pointer to prepared input vector
+**************************************************/
+void polyvec_basemul_acc_montgomery_prepared_2x(poly *r0,
+                                                poly *r1,
+                                                const polyvec *a0,
+                                                const polyvec *a1,
+                                                const polyvec_prepared *b)
+{
+  basemul_accprep2_avx(r0->vec, r1->vec, a0->vec[0].vec, a1->vec[0].vec, b->vec, qdata.vec);
 }
 
 /*************************************************
@@ -9,8 +9,17 @@ typedef struct{
   poly vec[KYBER_K];
 } polyvec;
 
+/* Vector of polynomials in NTT domain prepared as operand of
+ * polyvec_basemul_acc_montgomery_prepared(_2x) (interleaved and with
+ * the roots folded in); twice the size of a polyvec */
+typedef ALIGNED_INT16(2*KYBER_K*KYBER_N) polyvec_prepared;
+
 #define polyvec_compress KYBER_NAMESPACE(polyvec_compress)
 void polyvec_compress(uint8_t r[KYBER_POLYVECCOMPRESSEDBYTES+2], const polyvec *a);
+#define polyvec_invntt_add_compress KYBER_NAMESPACE(polyvec_invntt_add_compress)
+void polyvec_invntt_add_compress(uint8_t r[KYBER_POLYVECCOMPRESSEDBYTES+2],
+                                 polyvec *a,
+                                 const polyvec *e);
 #define polyvec_decompress KYBER_NAMESPACE(polyvec_decompress)
 void polyvec_decompress(polyvec *r, const uint8_t a[KYBER_POLYVECCOMPRESSEDBYTES+12]);
 
@@ -26,6 +35,25 @@ void polyvec_invntt_tomont(polyvec *r);
 
 #define polyvec_basemul_acc_montgomery KYBER_NAMESPACE(polyvec_basemul_acc_montgomery)
 void polyvec_basemul_acc_montgomery(poly *r, const polyvec *a, const polyvec *b);
+#define polyvec_basemul_acc_montgomery_2x KYBER_NAMESPACE(polyvec_basemul_acc_montgomery_2x)
+void polyvec_basemul_acc_montgomery_2x(poly *r0,
+                                       poly *r1,
+                                       const polyvec *a,
+                                       const polyvec *b0,
+                                       const polyvec *b1);
+
+#define polyvec_basemul_prepare KYBER_NAMESPACE(polyvec_basemul_prepare)
+void polyvec_basemul_prepare(polyvec_prepared *r, const polyvec *b);
+#define polyvec_basemul_acc_montgomery_prepared KYBER_NAMESPACE(polyvec_basemul_acc_montgomery_prepared)
+void polyvec_basemul_acc_montgomery_prepared(poly *r,
+                                             const polyvec *a,
+                                             const polyvec_prepared *b);
+#define polyvec_basemul_acc_montgomery_prepared_2x KYBER_NAMESPACE(polyvec_basemul_acc_montgomery_prepared_2x)
+void polyvec_basemul_acc_montgomery_prepared_2x(poly *r0,
+                                                poly *r1,
+                                                const polyvec *a0,
+                                                const polyvec *a1,
+                                                const polyvec_prepared *b);
 
 #define polyvec_reduce KYBER_NAMESPACE(polyvec_reduce)
 void polyvec_reduce(polyvec *r);
@@ -0,0 +1,64 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "params.h"
+#include "profile.h"
+
+/* Only built with make PROFILE=1, which defines KYBER_PROFILE */
+
+mkem_profile profile_totals;
+
+static const char *const profile_names[MKEM_PROFILE_NPHASES] = {
+  "hash", "matrix", "noise", "ntt", "basemul", "compress", "verify"
+};
+
+/*************************************************
+* Name:        crypto_mkem_profile_read
+*
+* Description: Reads the totals accumulated per phase since the start of
+*              the program or the last crypto_mkem_profile_reset, over all
+*              threads. Phases are timed inside crypto_mkem_enc (and the
+*              other encapsulation functions), indcpa_enc_c1, indcpa_enc_c2
+*              and crypto_mkem_dec.
+*
+* Arguments:   - mkem_profile *profile: pointer to output totals
+**************************************************/
+void crypto_mkem_profile_read(mkem_profile *profile)
+{
+  unsigned int i;
+
+  for(i=0;i<MKEM_PROFILE_NPHASES;i++) {
+    profile->cycles[i] = __atomic_load_n(&profile_totals.cycles[i], __ATOMIC_RELAXED);
+    profile->calls[i] = __atomic_load_n(&profile_totals.calls[i], __ATOMIC_RELAXED);
+  }
+}
+
+/*************************************************
+* Name:        crypto_mkem_profile_reset
+*
+* Description: Sets all totals to zero
+**************************************************/
+void crypto_mkem_profile_reset(void)
+{
+  unsigned int i;
+
+  for(i=0;i<MKEM_PROFILE_NPHASES;i++) {
+    __atomic_store_n(&profile_totals.cycles[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&profile_totals.calls[i], 0, __ATOMIC_RELAXED);
+  }
+}
+
+/*************************************************
+* Name:        crypto_mkem_profile_name
+*
+* Description: Returns the name of a phase, e.g. for printing the totals
+*
+* Arguments:   - unsigned int phase: one of the MKEM_PROFILE_* constants
+*
+* Returns pointer to a constant string, or NULL for an unknown phase
+**************************************************/
+const char *crypto_mkem_profile_name(unsigned int phase)
+{
+  if(phase >= MKEM_PROFILE_NPHASES)
+    return NULL;
+  return profile_names[phase];
+}
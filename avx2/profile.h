@@ -0,0 +1,72 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "params.h"
+
+/* Phases of encapsulation and decapsulation accumulated by the
+ * profiler; compression includes the inverse NTT that
+ * polyvec_invntt_add_compress fuses with it */
+#define MKEM_PROFILE_HASH 0
+#define MKEM_PROFILE_MATRIX 1
+#define MKEM_PROFILE_NOISE 2
+#define MKEM_PROFILE_NTT 3
+#define MKEM_PROFILE_BASEMUL 4
+#define MKEM_PROFILE_COMPRESS 5
+#define MKEM_PROFILE_VERIFY 6
+#define MKEM_PROFILE_NPHASES 7
+
+/* Time stamp counter ticks spent in, and number of timed sections of,
+ * every phase */
+typedef struct {
+  uint64_t cycles[MKEM_PROFILE_NPHASES];
+  uint64_t calls[MKEM_PROFILE_NPHASES];
+} mkem_profile;
+
+#ifdef KYBER_PROFILE
+
+#define profile_totals KYBER_NAMESPACE(profile_totals)
+extern mkem_profile profile_totals;
+
+static inline uint64_t profile_cycles(void) {
+  uint64_t result;
+
+  __asm__ volatile ("rdtsc; shlq $32,%%rdx; orq %%rdx,%%rax"
+    : "=a" (result) : : "%rdx");
+
+  return result;
+}
+
+/* Relaxed atomic additions, the workers of an mkem_pool share the totals */
+static inline void profile_add(unsigned int phase, uint64_t cycles) {
+  __atomic_fetch_add(&profile_totals.cycles[phase], cycles, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&profile_totals.calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+/* PROFILE_START declares a timestamp t; PROFILE_LAP adds the ticks since
+ * t to a phase and restarts t, so that consecutive sections need one
+ * timestamp each; PROFILE_RESTART skips code that is timed elsewhere */
+#define PROFILE_START(t) uint64_t t = profile_cycles()
+#define PROFILE_RESTART(t) ((t) = profile_cycles())
+#define PROFILE_LAP(t, phase) \
+  do { \
+    uint64_t profile_now = profile_cycles(); \
+    profile_add(phase, profile_now - (t)); \
+    (t) = profile_now; \
+  } while(0)
+
+void crypto_mkem_profile_read(mkem_profile *profile);
+
+void crypto_mkem_profile_reset(void);
+
+const char *crypto_mkem_profile_name(unsigned int phase);
+
+#else
+
+#define PROFILE_START(t)
+#define PROFILE_RESTART(t)
+#define PROFILE_LAP(t, phase)
+
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "randombytes.h"
 
 #ifdef _WIN32
@@ -9,6 +10,8 @@
 #else
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
+#include "fips202.h"
 #ifdef __linux__
 #define _GNU_SOURCE
 #include <unistd.h>
@@ -19,7 +22,7 @@
 #endif
 
 #ifdef _WIN32
-void randombytes(uint8_t *out, size_t outlen) {
+static void randombytes_system(uint8_t *out, size_t outlen) {
   HCRYPTPROV ctx;
   size_t len;
 
@@ -39,7 +42,7 @@ void randombytes(uint8_t *out, size_t outlen) {
     abort();
 }
 #elif defined(__linux__) && defined(SYS_getrandom)
-void randombytes(uint8_t *out, size_t outlen) {
+static void randombytes_system(uint8_t *out, size_t outlen) {
   ssize_t ret;
 
   while(outlen > 0) {
@@ -54,7 +57,7 @@ void randombytes(uint8_t *out, size_t outlen) {
   }
 }
 #else
-void randombytes(uint8_t *out, size_t outlen) {
+static void randombytes_system(uint8_t *out, size_t outlen) {
   static int fd = -1;
   ssize_t ret;
 
@@ -78,3 +81,170 @@ void randombytes(uint8_t *out, size_t outlen) {
   }
 }
 #endif
+
+#ifdef _WIN32
+void randombytes(uint8_t *out, size_t outlen) {
+  randombytes_system(out, outlen);
+}
+
+int randombytes_select(int source) {
+  return (source == RANDOMBYTES_SYSTEM) ? 0 : -1;
+}
+#else
+/* Bytes served from one refill of the per-thread buffer */
+#define DRBG_BUFBYTES 512
+/* Refills between two reseeds from the system randomness */
+#define DRBG_RESEED_INTERVAL 65536
+
+typedef struct {
+  uint8_t key[32];
+  uint8_t buf[DRBG_BUFBYTES];
+  size_t pos;
+  unsigned long refills;
+  unsigned long generation;
+  int seeded;
+} drbg_state;
+
+static __thread drbg_state drbg;
+/* Incremented in the child after every fork */
+static unsigned long fork_generation;
+static pthread_once_t drbg_once = PTHREAD_ONCE_INIT;
+/* Set to the state of every seeded thread, whose destructor erases it */
+static pthread_key_t drbg_key;
+static int randombytes_source = RANDOMBYTES_SYSTEM;
+
+/*************************************************
+* Name:        drbg_wipe
+*
+* Description: Overwrites memory with zeros through a volatile pointer,
+*              so that the stores are not removed as dead
+**************************************************/
+static void drbg_wipe(void *p, size_t len) {
+  volatile uint8_t *v = p;
+
+  while(len--)
+    *v++ = 0;
+}
+
+static void drbg_atfork_child(void) {
+  fork_generation++;
+}
+
+static void drbg_thread_exit(void *s) {
+  drbg_wipe(s, sizeof(drbg_state));
+}
+
+static void drbg_init(void) {
+  pthread_atfork(NULL, NULL, drbg_atfork_child);
+  pthread_key_create(&drbg_key, drbg_thread_exit);
+}
+
+/*************************************************
+* Name:        drbg_reseed
+*
+* Description: Mixes 32 bytes of system randomness into the key of the
+*              DRBG of the calling thread and discards buffered output;
+*              on first use, registers the state to be erased when the
+*              thread exits
+**************************************************/
+static void drbg_reseed(drbg_state *s) {
+  uint8_t in[64];
+  keccak_state state;
+
+  if(!s->seeded)
+    pthread_setspecific(drbg_key, s);
+
+  memcpy(in, s->key, 32);
+  randombytes_system(in+32, 32);
+  shake256_absorb_once(&state, in, 64);
+  shake256_squeeze(s->key, 32, &state);
+  drbg_wipe(in, sizeof(in));
+  drbg_wipe(&state, sizeof(state));
+
+  memset(s->buf, 0, DRBG_BUFBYTES);
+  s->pos = DRBG_BUFBYTES;
+  s->refills = 0;
+  s->generation = fork_generation;
+  s->seeded = 1;
+}
+
+/*************************************************
+* Name:        drbg_refill
+*
+* Description: Expands the key with SHAKE256 into a new key and a full
+*              buffer; the old key and the temporaries (including the
+*              Keccak state, from which the key could be recovered) are
+*              overwritten, so bytes served earlier cannot be recomputed
+**************************************************/
+static void drbg_refill(drbg_state *s) {
+  uint8_t out[32+DRBG_BUFBYTES];
+  keccak_state state;
+
+  shake256_absorb_once(&state, s->key, 32);
+  shake256_squeeze(out, sizeof(out), &state);
+  memcpy(s->key, out, 32);
+  memcpy(s->buf, out+32, DRBG_BUFBYTES);
+  drbg_wipe(out, sizeof(out));
+  drbg_wipe(&state, sizeof(state));
+  s->pos = 0;
+  s->refills++;
+}
+
+static void randombytes_drbg(uint8_t *out, size_t outlen) {
+  drbg_state *s = &drbg;
+  size_t len;
+
+  if(!s->seeded || s->generation != fork_generation || s->refills >= DRBG_RESEED_INTERVAL)
+    drbg_reseed(s);
+
+  while(outlen > 0) {
+    if(s->pos == DRBG_BUFBYTES)
+      drbg_refill(s);
+
+    len = DRBG_BUFBYTES - s->pos;
+    if(len > outlen)
+      len = outlen;
+    memcpy(out, s->buf+s->pos, len);
+    /* Served bytes do not stay in memory */
+    memset(s->buf+s->pos, 0, len);
+
+    s->pos += len;
+    out += len;
+    outlen -= len;
+  }
+}
+
+void randombytes(uint8_t *out, size_t outlen) {
+  if(randombytes_source == RANDOMBYTES_DRBG)
+    randombytes_drbg(out, outlen);
+  else
+    randombytes_system(out, outlen);
+}
+
+/*************************************************
+* Name:        randombytes_select
+*
+* Description: Selects the source of randombytes; has to be called before
+*              other threads use randombytes.
+*              RANDOMBYTES_SYSTEM (the default) asks the operating system
+*              on every call. RANDOMBYTES_DRBG serves requests from a
+*              per-thread buffer filled by a SHAKE256-based generator,
+*              which is seeded from the operating system on first use in
+*              every thread, reseeded after DRBG_RESEED_INTERVAL refills,
+*              reseeded in the child after fork, and erased when its
+*              thread exits.
+*
+* Arguments:   - int source: RANDOMBYTES_SYSTEM or RANDOMBYTES_DRBG
+*
+* Returns 0 on success, -1 for an unknown source
+**************************************************/
+int randombytes_select(int source) {
+  if(source != RANDOMBYTES_SYSTEM && source != RANDOMBYTES_DRBG)
+    return -1;
+
+  if(source == RANDOMBYTES_DRBG)
+    pthread_once(&drbg_once, drbg_init);
+  randombytes_source = source;
+  return 0;
+}
+#endif
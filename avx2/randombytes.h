@@ -4,6 +4,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define RANDOMBYTES_SYSTEM 0
+#define RANDOMBYTES_DRBG   1
+
 void randombytes(uint8_t *out, size_t outlen);
 
+int randombytes_select(int source);
+
 #endif
@@ -7,8 +7,10 @@
 
 #include "fips202.h"
 #include "fips202x4.h"
+#include "fips202x8.h"
 
 typedef keccak_state xof_state;
+typedef keccak_state hash_h_state;
 
 #define kyber_shake128_absorb KYBER_NAMESPACE(kyber_shake128_absorb)
 void kyber_shake128_absorb(keccak_state *s,
@@ -25,7 +27,15 @@ void kyber_shake256_prf(uint8_t *out,
 #define XOF_BLOCKBYTES SHAKE128_RATE
 
 #define hash_h(OUT, IN, INBYTES) sha3_256(OUT, IN, INBYTES)
+#define hash_h_init(STATE) sha3_256_init(STATE)
+#define hash_h_absorb(STATE, IN, INBYTES) sha3_256_absorb(STATE, IN, INBYTES)
+#define hash_h_finalize(OUT, STATE) sha3_256_finalize(OUT, STATE)
 #define hash_g(OUT, IN, INBYTES) sha3_512(OUT, IN, INBYTES)
+#define hash_h4x(OUT0, OUT1, OUT2, OUT3, IN0, IN1, IN2, IN3, INBYTES) \
+        sha3_256x4(OUT0, OUT1, OUT2, OUT3, IN0, IN1, IN2, IN3, INBYTES)
+#ifdef KYBER_KECCAK8X
+#define hash_h8x(OUT, IN, INBYTES) sha3_256x8(OUT, IN, INBYTES)
+#endif
 #define xof_absorb(STATE, SEED, X, Y) kyber_shake128_absorb(STATE, SEED, X, Y)
 #define xof_squeezeblocks(OUT, OUTBLOCKS, STATE) \
         shake128_squeezeblocks(OUT, OUTBLOCKS, STATE)
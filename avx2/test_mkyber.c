@@ -1,12 +1,28 @@
+#include <limits.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "mkem.h"
+#include "mkem_keydir.h"
+#include "mkem_pool.h"
+#include "mkem_session.h"
+#include "profile.h"
 #include "randombytes.h"
 
 #define NTESTS 1000
 #define NKEYS 5
+/* Enough keys for two groups of eight and a tail of three */
+#define NWIDEKEYS 19
+#define NTHREADS 3
+#define NCTS 6
+/* Spans more than one window of the key directory encapsulation */
+#define NDIRKEYS 67
+/* Twice the stack the session functions overwrite after every call */
+#define NSTACKBYTES (2*65536)
 
 static int test_keys(void)
 {
@@ -74,6 +90,847 @@ static int test_keys(void)
   return ret;
 }
 
+static int test_batch_sizes(void)
+{
+  uint8_t *pk[NKEYS];
+  uint8_t *sk[NKEYS];
+  
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2[NKEYS];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  mkem_recipient *rcpt;
+
+  size_t i, n;
+  int ret = 0;
+
+  rcpt = aligned_alloc(32, NKEYS*sizeof(mkem_recipient));
+  for(i=0;i<NKEYS;i++)
+  {
+    pk[i] = malloc(MKYBER_PUBLICKEYBYTES);
+    sk[i] = malloc(MKYBER_SECRETKEYBYTES);
+    c2[i] = malloc(MKYBER_C2BYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+
+  for(i=0;i<NKEYS;i++)
+  {
+    crypto_mkem_keypair(pk[i], sk[i], seed);
+    crypto_mkem_prepare_recipient(&rcpt[i], pk[i]);
+  }
+
+  /* Recipients are processed in groups of four; exercise all remainders */
+  for(n=1;n<=NKEYS && !ret;n++)
+  {
+    crypto_mkem_enc(c1, c2, key_a, seed, n, pk);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2[i], sk[i]);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+    }
+
+    crypto_mkem_enc_prepared(c1, c2, key_a, seed, n, rcpt);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2[i], sk[i]);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (prepared batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+    }
+  }
+
+  for(i=0;i<NKEYS;i++)
+  {
+    free(pk[i]);
+    free(sk[i]);
+    free(c2[i]);
+  }
+  free(rcpt);
+
+  return ret;
+}
+
+static int test_wide_batches(void)
+{
+  uint8_t *pk[NWIDEKEYS];
+  uint8_t *sk[NWIDEKEYS];
+
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2[NWIDEKEYS];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  /* Groups of eight (with the 8-way Keccak) followed by a single
+   * recipient or by a group of four padded with a dummy recipient */
+  const size_t sizes[4] = {9, 11, 17, NWIDEKEYS};
+  size_t i, n;
+  int ret = 0;
+
+  for(i=0;i<NWIDEKEYS;i++)
+  {
+    pk[i] = malloc(MKYBER_PUBLICKEYBYTES);
+    sk[i] = malloc(MKYBER_SECRETKEYBYTES);
+    c2[i] = malloc(MKYBER_C2BYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+  for(i=0;i<NWIDEKEYS;i++)
+    crypto_mkem_keypair(pk[i], sk[i], seed);
+
+  for(n=0;n<4 && !ret;n++)
+  {
+    crypto_mkem_enc(c1, c2, key_a, seed, sizes[n], pk);
+    for(i=0;i<sizes[n];i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2[i], sk[i]);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (batch of %lu) at position %lu\n", sizes[n], i);
+        ret = 1;
+        break;
+      }
+    }
+  }
+
+  for(i=0;i<NWIDEKEYS;i++)
+  {
+    free(pk[i]);
+    free(sk[i]);
+    free(c2[i]);
+  }
+
+  return ret;
+}
+
+static int test_seedctx(void)
+{
+  uint8_t pk[MKYBER_PUBLICKEYBYTES];
+  uint8_t sk[MKYBER_SECRETKEYBYTES];
+
+  uint8_t seed[KYBER_SYMBYTES];
+  uint8_t rnd[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t cmp1[MKYBER_C1BYTES];
+  uint8_t fwd[MKYBER_FWDBYTES];
+  uint8_t c2[MKYBER_C2BYTES];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+  const uint8_t zero[KYBER_SSBYTES] = {0};
+
+  mkem_seedctx ctx, ctx2;
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair(pk, sk, seed);
+  crypto_mkem_seedctx_init(&ctx, seed);
+
+  /* Context variants have to agree with the plain split API */
+  randombytes(rnd, KYBER_SYMBYTES);
+  crypto_mkem_enc_c1(cmp1, key_b, fwd, seed, rnd);
+  crypto_mkem_enc_c1_ctx(c1, key_a, fwd, &ctx, rnd);
+  if(memcmp(c1, cmp1, MKYBER_C1BYTES)) {
+    printf("ERROR c1 (seed context)\n");
+    return 1;
+  }
+  crypto_mkem_enc_c2(c2, pk, rnd, fwd);
+
+  if(crypto_mkem_dec_ctx(key_b, c1, c2, sk, &ctx) || memcmp(key_a, key_b, KYBER_SSBYTES)) {
+    printf("ERROR keys (seed context)\n");
+    return 1;
+  }
+
+  /* A context for another seed must be rejected and must not leave
+   * the previous key in the output */
+  seed[0] ^= 1;
+  crypto_mkem_seedctx_init(&ctx2, seed);
+  if(!crypto_mkem_dec_ctx(key_b, c1, c2, sk, &ctx2) || memcmp(key_b, zero, KYBER_SSBYTES)) {
+    printf("ERROR seed context for wrong seed accepted\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+static int test_fwd(void)
+{
+  uint8_t pk[MKYBER_PUBLICKEYBYTES];
+  uint8_t sk[MKYBER_SECRETKEYBYTES];
+
+  uint8_t seed[KYBER_SYMBYTES];
+  uint8_t rnd[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t cmp1[MKYBER_C1BYTES];
+  uint8_t fwd[MKYBER_FWDBYTES];
+  uint8_t cmpfwd[MKYBER_FWDBYTES];
+  uint8_t c2[MKYBER_C2BYTES];
+  uint8_t cmp2[MKYBER_C2BYTES];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  mkem_seedctx ctx;
+  mkem_fwd tfwd, tfwd2;
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair(pk, sk, seed);
+  crypto_mkem_seedctx_init(&ctx, seed);
+
+  /* In-memory forwarded information has to agree with the serialized form */
+  randombytes(rnd, KYBER_SYMBYTES);
+  crypto_mkem_enc_c1(cmp1, key_b, fwd, seed, rnd);
+  crypto_mkem_enc_c2(cmp2, pk, rnd, fwd);
+
+  crypto_mkem_enc_c1_fwd(c1, key_a, &tfwd, &ctx, rnd);
+  crypto_mkem_enc_c2_fwd(c2, pk, rnd, &tfwd);
+  crypto_mkem_fwd_tobytes(cmpfwd, &tfwd);
+  if(memcmp(c1, cmp1, MKYBER_C1BYTES) || memcmp(c2, cmp2, MKYBER_C2BYTES) ||
+     memcmp(fwd, cmpfwd, MKYBER_FWDBYTES) || memcmp(key_a, key_b, KYBER_SSBYTES)) {
+    printf("ERROR forwarded information (in-memory form)\n");
+    return 1;
+  }
+
+  crypto_mkem_fwd_frombytes(&tfwd2, fwd);
+  crypto_mkem_enc_c2_fwd(c2, pk, rnd, &tfwd2);
+  if(memcmp(c2, cmp2, MKYBER_C2BYTES)) {
+    printf("ERROR forwarded information (de-serialized)\n");
+    return 1;
+  }
+
+  crypto_mkem_dec(key_b, c1, c2, sk);
+  if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+    printf("ERROR keys (in-memory forwarded information)\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+static int test_pool(mkem_pool *pool)
+{
+  uint8_t *pk[NKEYS];
+  uint8_t *sk[NKEYS];
+  
+  uint8_t seed[KYBER_SYMBYTES];
+  uint8_t rnd[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2[NKEYS];
+  uint8_t cmp2[MKYBER_C2BYTES];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  mkem_seedctx ctx;
+  mkem_fwd fwd;
+
+  size_t i, n;
+  int ret = 0;
+
+  for(i=0;i<NKEYS;i++)
+  {
+    pk[i] = malloc(MKYBER_PUBLICKEYBYTES);
+    sk[i] = malloc(MKYBER_SECRETKEYBYTES);
+    c2[i] = malloc(MKYBER_C2BYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_seedctx_init(&ctx, seed);
+
+  for(i=0;i<NKEYS;i++)
+    crypto_mkem_keypair(pk[i], sk[i], seed);
+
+  for(n=1;n<=NKEYS && !ret;n++)
+  {
+    crypto_mkem_enc_pool(c1, c2, key_a, seed, n, pk, pool);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2[i], sk[i]);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (thread pool, batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+    }
+
+    crypto_mkem_enc_pipelined(c1, c2, key_a, seed, n, pk, pool);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2[i], sk[i]);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (pipelined, batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+    }
+
+    /* Has to be bit-identical to the serial split API */
+    randombytes(rnd, KYBER_SYMBYTES);
+    crypto_mkem_enc_c1_fwd(c1, key_a, &fwd, &ctx, rnd);
+    crypto_mkem_enc_c2_pool(c2, n, pk, rnd, &fwd, pool);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_enc_c2_fwd(cmp2, pk[i], rnd, &fwd);
+      if(memcmp(c2[i], cmp2, MKYBER_C2BYTES)) {
+        printf("ERROR c2 (thread pool, batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+    }
+  }
+
+  for(i=0;i<NKEYS;i++)
+  {
+    free(pk[i]);
+    free(sk[i]);
+    free(c2[i]);
+  }
+
+  return ret;
+}
+
+/* Collects the output of crypto_mkem_enc_stream */
+typedef struct {
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t c2s[NKEYS][MKYBER_C2BYTES];
+  size_t next;
+  size_t batch;
+  size_t abort_at;
+  int error;
+} test_sink;
+
+static int test_sink_c1(void *arg, const uint8_t *c1)
+{
+  test_sink *t = arg;
+
+  memcpy(t->c1, c1, MKYBER_C1BYTES);
+  return 0;
+}
+
+static int test_sink_c2(void *arg, size_t index, const uint8_t *c2s, size_t count)
+{
+  test_sink *t = arg;
+
+  /* Batches have to arrive in order and within the configured size */
+  if(index != t->next || count == 0 || count > t->batch || index+count > NKEYS) {
+    t->error = 1;
+    return 1;
+  }
+  if(index >= t->abort_at)
+    return 1;
+
+  memcpy(t->c2s[index], c2s, count*MKYBER_C2BYTES);
+  t->next += count;
+  return 0;
+}
+
+static int test_stream(mkem_pool *pool)
+{
+  uint8_t *pk[NKEYS];
+  uint8_t *sk[NKEYS];
+
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+  const uint8_t zero[KYBER_SSBYTES] = {0};
+
+  test_sink t;
+  mkem_sink sink = {test_sink_c1, test_sink_c2, &t};
+  mkem_pool *pools[2] = {NULL, pool};
+  /* Batch sizes beyond the number of keys are clamped, even the largest */
+  const size_t batches[6] = {1, 2, NKEYS-1, NKEYS, NKEYS+1, SIZE_MAX};
+  size_t i, p, b, batch;
+  int ret = 0;
+
+  for(i=0;i<NKEYS;i++)
+  {
+    pk[i] = malloc(MKYBER_PUBLICKEYBYTES);
+    sk[i] = malloc(MKYBER_SECRETKEYBYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+  for(i=0;i<NKEYS;i++)
+    crypto_mkem_keypair(pk[i], sk[i], seed);
+
+  for(p=0;p<2 && !ret;p++)
+  {
+    for(b=0;b<6 && !ret;b++)
+    {
+      batch = batches[b];
+      t.next = 0;
+      t.batch = batch;
+      t.abort_at = NKEYS;
+      t.error = 0;
+      if(crypto_mkem_enc_stream(key_a, seed, NKEYS, pk, batch, &sink, pools[p]) || t.error || t.next != NKEYS) {
+        printf("ERROR stream (pool %lu, batch size %lu)\n", p, batch);
+        ret = 1;
+        break;
+      }
+      for(i=0;i<NKEYS;i++)
+      {
+        crypto_mkem_dec(key_b, t.c1, t.c2s[i], sk[i]);
+        if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+          printf("ERROR keys (stream, pool %lu, batch size %lu) at position %lu\n", p, batch, i);
+          ret = 1;
+          break;
+        }
+      }
+    }
+
+    /* The sink stops the encapsulation after the first batch */
+    t.next = 0;
+    t.batch = 2;
+    t.abort_at = 2;
+    t.error = 0;
+    if(!ret && (crypto_mkem_enc_stream(key_a, seed, NKEYS, pk, 2, &sink, pools[p]) != -1 || t.error || t.next != 2
+                || memcmp(key_a, zero, KYBER_SSBYTES))) {
+      printf("ERROR aborted stream (pool %lu)\n", p);
+      ret = 1;
+    }
+  }
+
+  for(i=0;i<NKEYS;i++)
+  {
+    free(pk[i]);
+    free(sk[i]);
+  }
+
+  return ret;
+}
+
+/* Searches the stack below the frame of the caller, where the functions
+ * it called before left their temporaries, for len bytes equal to x */
+static __attribute__((noinline)) int stack_contains(const uint8_t *x, size_t len)
+{
+  uint8_t buf[NSTACKBYTES];
+  const volatile uint8_t *p = buf;
+  size_t i, j;
+
+  /* The contents of buf are whatever is left on the stack */
+  __asm__ volatile ("" : : "r" (buf) : "memory");
+  for(i=0;i+len<=sizeof(buf);i++) {
+    for(j=0;j<len && p[i+j] == x[j];j++)
+      ;
+    if(j == len)
+      return 1;
+  }
+  return 0;
+}
+
+static int test_session(void)
+{
+  uint8_t *pk[NKEYS];
+  uint8_t *sk[NKEYS];
+
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2[NKEYS];
+  uint8_t cmp2[MKYBER_C2BYTES];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+  uint8_t msg[KYBER_INDCPA_MSGBYTES];
+
+  mkem_session *session;
+  size_t i;
+  int ret = 0;
+
+  for(i=0;i<NKEYS;i++)
+  {
+    pk[i] = malloc(MKYBER_PUBLICKEYBYTES);
+    sk[i] = malloc(MKYBER_SECRETKEYBYTES);
+    c2[i] = malloc(MKYBER_C2BYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+  for(i=0;i<NKEYS;i++)
+    crypto_mkem_keypair(pk[i], sk[i], seed);
+
+  session = crypto_mkem_session_new(c1, key_a, seed);
+  if(session == NULL) {
+    printf("ERROR creating session\n");
+    ret = 1;
+  }
+
+  /* Bulk add of the first recipients, then one at a time */
+  if(!ret) {
+    crypto_mkem_session_add_batch(session, c2, NKEYS-1, pk);
+    crypto_mkem_session_add(session, c2[NKEYS-1], pk[NKEYS-1]);
+  }
+  for(i=0;i<NKEYS && !ret;i++)
+  {
+    crypto_mkem_dec(key_b, c1, c2[i], sk[i]);
+    if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+      printf("ERROR keys (session) at position %lu\n", i);
+      ret = 1;
+    }
+
+    /* Both ways of adding give the same ciphertext */
+    crypto_mkem_session_add(session, cmp2, pk[i]);
+    if(memcmp(c2[i], cmp2, MKYBER_C2BYTES)) {
+      printf("ERROR c2 (session) at position %lu\n", i);
+      ret = 1;
+    }
+  }
+
+  /* The message of the session must not be left on the stack */
+  if(!ret) {
+    indcpa_dec(msg, c1, c2[0], sk[0]);
+    crypto_mkem_session_add_batch(session, c2, NKEYS, pk);
+    if(stack_contains(msg, sizeof(msg))) {
+      printf("ERROR session message left on the stack (batch)\n");
+      ret = 1;
+    }
+    crypto_mkem_session_add(session, c2[0], pk[0]);
+    if(stack_contains(msg, sizeof(msg))) {
+      printf("ERROR session message left on the stack\n");
+      ret = 1;
+    }
+  }
+
+  crypto_mkem_session_free(session);
+  for(i=0;i<NKEYS;i++)
+  {
+    free(pk[i]);
+    free(sk[i]);
+    free(c2[i]);
+  }
+
+  return ret;
+}
+
+static int test_strided(void)
+{
+  uint8_t *pks, *sks;
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  /* Leaves a gap after every second ciphertext component */
+  const size_t c2stride = MKYBER_C2BYTES+3;
+  uint8_t c2s[NKEYS*(MKYBER_C2BYTES+3)];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  size_t i, n;
+  int ret = 0;
+
+  pks = malloc(NKEYS*MKYBER_PUBLICKEYBYTES);
+  sks = malloc(NKEYS*MKYBER_SECRETKEYBYTES);
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair_batch(pks, sks, NKEYS, seed);
+
+  for(n=1;n<=NKEYS && !ret;n++)
+  {
+    memset(c2s, 0xAA, sizeof(c2s));
+    crypto_mkem_enc_strided(c1, c2s, c2stride, key_a, seed, n, pks, MKYBER_PUBLICKEYBYTES);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2s+i*c2stride, sks+i*MKYBER_SECRETKEYBYTES);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (strided, batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+      if(c2s[i*c2stride+MKYBER_C2BYTES] != 0xAA) {
+        printf("ERROR stride gap overwritten (strided, batch of %lu) at position %lu\n", n, i);
+        ret = 1;
+        break;
+      }
+    }
+  }
+
+  free(pks);
+  free(sks);
+
+  return ret;
+}
+
+/* Writes the first len bytes of a key directory, with the byte at off
+ * XORed with mask, to a temporary file and opens it; returns 1 if
+ * crypto_mkem_keydir_open accepts it, 0 if it rejects it and -1 if the
+ * file cannot be written */
+static int keydir_accepts(uint8_t *buf, size_t len, size_t off, uint8_t mask)
+{
+  char path[] = "/tmp/mkyber_keydirXXXXXX";
+  mkem_keydir dir;
+  int fd, r = -1;
+
+  fd = mkstemp(path);
+  if(fd < 0)
+    return -1;
+  buf[off] ^= mask;
+  if(write(fd, buf, len) == (ssize_t)len) {
+    r = !crypto_mkem_keydir_open(&dir, path);
+    if(r)
+      crypto_mkem_keydir_close(&dir);
+  }
+  buf[off] ^= mask;
+  close(fd);
+  unlink(path);
+  return r;
+}
+
+static int test_keydir(void)
+{
+  uint8_t *pks, *sks;
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2s;
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+  const uint8_t zero[KYBER_SSBYTES] = {0};
+
+  char path[] = "/tmp/mkyber_keydirXXXXXX";
+  const uint32_t flags[2] = {0, MKEM_KEYDIR_PREPARED};
+  mkem_keydir dir;
+  FILE *out;
+  uint8_t *buf;
+  size_t i, f, len, rec;
+  int fd, ret = 0;
+
+  pks = malloc(NDIRKEYS*MKYBER_PUBLICKEYBYTES);
+  sks = malloc(NDIRKEYS*MKYBER_SECRETKEYBYTES);
+  c2s = malloc(NDIRKEYS*MKYBER_C2BYTES);
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair_batch(pks, sks, NDIRKEYS, seed);
+
+  for(f=0;f<2 && !ret;f++)
+  {
+    memcpy(path+sizeof(path)-7, "XXXXXX", 6);
+    fd = mkstemp(path);
+    if(fd < 0 || crypto_mkem_keydir_write(fd, seed, pks, NDIRKEYS, flags[f])) {
+      printf("ERROR writing key directory (flags %u)\n", flags[f]);
+      ret = 1;
+    }
+    if(fd >= 0) {
+      close(fd);
+      if(!ret && crypto_mkem_keydir_open(&dir, path)) {
+        printf("ERROR opening key directory (flags %u)\n", flags[f]);
+        ret = 1;
+      }
+      unlink(path);
+    }
+    if(ret)
+      break;
+
+    if(dir.num_keys != NDIRKEYS || memcmp(dir.seed, seed, KYBER_SYMBYTES)) {
+      printf("ERROR key directory header (flags %u)\n", flags[f]);
+      ret = 1;
+    }
+    for(i=0;i<NDIRKEYS && !ret;i++)
+      if(memcmp(crypto_mkem_keydir_pk(&dir, i), pks+i*MKYBER_PUBLICKEYBYTES, MKYBER_PUBLICKEYBYTES)) {
+        printf("ERROR key directory (flags %u) public key at position %lu\n", flags[f], i);
+        ret = 1;
+      }
+
+    /* Contiguous output buffer */
+    crypto_mkem_enc_keydir(c1, c2s, key_a, &dir);
+    for(i=0;i<NDIRKEYS && !ret;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2s+i*MKYBER_C2BYTES, sks+i*MKYBER_SECRETKEYBYTES);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (key directory, flags %u) at position %lu\n", flags[f], i);
+        ret = 1;
+      }
+    }
+
+    /* Output file descriptor */
+    out = tmpfile();
+    if(out == NULL || crypto_mkem_enc_keydir_fd(c1, fileno(out), key_a, &dir)) {
+      printf("ERROR writing c2 (key directory, flags %u)\n", flags[f]);
+      ret = 1;
+    }
+    else {
+      rewind(out);
+      if(fread(c2s, MKYBER_C2BYTES, NDIRKEYS+1, out) != NDIRKEYS) {
+        printf("ERROR reading c2 (key directory, flags %u)\n", flags[f]);
+        ret = 1;
+      }
+    }
+    if(out != NULL)
+      fclose(out);
+    for(i=0;i<NDIRKEYS && !ret;i++)
+    {
+      crypto_mkem_dec(key_b, c1, c2s+i*MKYBER_C2BYTES, sks+i*MKYBER_SECRETKEYBYTES);
+      if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+        printf("ERROR keys (key directory fd, flags %u) at position %lu\n", flags[f], i);
+        ret = 1;
+      }
+    }
+
+    /* Failing writes leave no shared key behind */
+    fd = open("/dev/null", O_RDONLY);
+    if(!ret && (fd < 0 || crypto_mkem_enc_keydir_fd(c1, fd, key_a, &dir) != -1
+                || memcmp(key_a, zero, KYBER_SSBYTES))) {
+      printf("ERROR failed write (key directory fd, flags %u)\n", flags[f]);
+      ret = 1;
+    }
+    if(fd >= 0)
+      close(fd);
+
+    crypto_mkem_keydir_close(&dir);
+  }
+
+  /* Damaged headers, truncated files and corrupted prepared records */
+  len = MKEM_KEYDIR_HEADERBYTES + NDIRKEYS*MKEM_KEYDIR_PREPAREDBYTES;
+  rec = MKEM_KEYDIR_HEADERBYTES + (NDIRKEYS-1)*MKEM_KEYDIR_PREPAREDBYTES;
+  buf = malloc(len);
+  out = tmpfile();
+  if(ret || buf == NULL || out == NULL
+     || crypto_mkem_keydir_write(fileno(out), seed, pks, NDIRKEYS, MKEM_KEYDIR_PREPARED)
+     || fseek(out, 0, SEEK_SET) || fread(buf, 1, len, out) != len
+     || keydir_accepts(buf, len, 0, 0) != 1) {
+    if(!ret)
+      printf("ERROR writing prepared key directory\n");
+    ret = 1;
+  }
+  else if(keydir_accepts(buf, len, 0, 0x01)
+          || keydir_accepts(buf, len, 8, 0x01)
+          || keydir_accepts(buf, len, 12, 0x01)
+          /* Size and layout tag of mkem_recipient */
+          || keydir_accepts(buf, len, 64, 0x20)
+          || keydir_accepts(buf, len, 72, 0x01)
+          || keydir_accepts(buf, len-1, 0, 0)
+          /* Absorb position of the cached hash state */
+          || keydir_accepts(buf, len, rec+offsetof(mkem_recipient, hpk)+offsetof(keccak_state, pos)+3, 0x7f)
+          /* Sign bit of a coefficient of the cached public key */
+          || keydir_accepts(buf, len, rec+offsetof(mkem_recipient, ppk.pkpv1)+1, 0x80)) {
+    printf("ERROR invalid key directory accepted\n");
+    ret = 1;
+  }
+  if(out != NULL)
+    fclose(out);
+  free(buf);
+
+  free(pks);
+  free(sks);
+  free(c2s);
+
+  return ret;
+}
+
+static int test_dec_batch(void)
+{
+  uint8_t pk[MKYBER_PUBLICKEYBYTES];
+  uint8_t sk[MKYBER_SECRETKEYBYTES];
+  
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[NCTS][MKYBER_C1BYTES];
+  uint8_t c2[NCTS][MKYBER_C2BYTES];
+  uint8_t key_a[NCTS][KYBER_SSBYTES];
+  uint8_t key_b[NCTS][KYBER_SSBYTES];
+  uint8_t key_c[KYBER_SSBYTES];
+
+  const uint8_t *c1s[NCTS];
+  const uint8_t *c2s[NCTS];
+  uint8_t *pks[1];
+  uint8_t *c2p[1];
+  uint8_t *ss[NCTS];
+
+  size_t i, n;
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair(pk, sk, seed);
+  pks[0] = pk;
+
+  for(i=0;i<NCTS;i++)
+  {
+    c2p[0] = c2[i];
+    crypto_mkem_enc(c1[i], c2p, key_a[i], seed, 1, pks);
+    c1s[i] = c1[i];
+    c2s[i] = c2[i];
+    ss[i] = key_b[i];
+  }
+  /* Invalid ciphertext in the middle of the batch */
+  c2[NCTS/2][0] ^= 1;
+
+  /* Ciphertexts are processed in groups of four; exercise all remainders */
+  for(n=1;n<=NCTS;n++)
+  {
+    crypto_mkem_dec_batch(ss, c1s, c2s, n, sk);
+    for(i=0;i<n;i++)
+    {
+      crypto_mkem_dec(key_c, c1[i], c2[i], sk);
+      if(memcmp(key_b[i], key_c, KYBER_SSBYTES) ||
+         (i != NCTS/2 && memcmp(key_a[i], key_c, KYBER_SSBYTES))) {
+        printf("ERROR keys (batch decapsulation of %lu) at position %lu\n", n, i);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int test_keypair_batch(void)
+{
+  uint8_t *pks;
+  uint8_t *sks;
+  uint8_t *pk[NKEYS];
+  
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2[NKEYS];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  size_t i;
+  int ret = 0;
+
+  pks = malloc(NKEYS*MKYBER_PUBLICKEYBYTES);
+  sks = malloc(NKEYS*MKYBER_SECRETKEYBYTES);
+  for(i=0;i<NKEYS;i++)
+  {
+    pk[i] = pks+i*MKYBER_PUBLICKEYBYTES;
+    c2[i] = malloc(MKYBER_C2BYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair_batch(pks, sks, NKEYS, seed);
+
+  crypto_mkem_enc(c1, c2, key_a, seed, NKEYS, pk);
+  for(i=0;i<NKEYS;i++)
+  {
+    crypto_mkem_dec(key_b, c1, c2[i], sks+i*MKYBER_SECRETKEYBYTES);
+    if(memcmp(key_a, key_b, KYBER_SSBYTES)) {
+      printf("ERROR keys (batch key generation) at position %lu\n", i);
+      ret = 1;
+      break;
+    }
+  }
+
+  for(i=0;i<NKEYS;i++)
+    free(c2[i]);
+  free(pks);
+  free(sks);
+
+  return ret;
+}
+
 static int test_invalid_sk(void)
 {
   uint8_t *pk[NKEYS];
@@ -240,18 +1097,165 @@ static int test_invalid_ciphertext(void)
   return ret;
 }
 
+static int test_drbg(void)
+{
+  uint8_t a[KYBER_SYMBYTES];
+  uint8_t b[KYBER_SYMBYTES];
+  int fds[2], status;
+  pid_t pid;
+
+  if(randombytes_select(RANDOMBYTES_DRBG)) {
+    printf("ERROR selecting DRBG\n");
+    return 1;
+  }
+  /* Seed and fill the buffer of this thread */
+  randombytes(a, KYBER_SYMBYTES);
+
+  /* Parent and child have to continue with different outputs */
+  if(pipe(fds))
+    return 1;
+  pid = fork();
+  if(pid < 0)
+    return 1;
+  if(pid == 0) {
+    randombytes(b, KYBER_SYMBYTES);
+    _exit(write(fds[1], b, KYBER_SYMBYTES) != KYBER_SYMBYTES);
+  }
+  randombytes(a, KYBER_SYMBYTES);
+  if(read(fds[0], b, KYBER_SYMBYTES) != KYBER_SYMBYTES)
+    memcpy(b, a, KYBER_SYMBYTES);
+  waitpid(pid, &status, 0);
+  close(fds[0]);
+  close(fds[1]);
+
+  if(!memcmp(a, b, KYBER_SYMBYTES)) {
+    printf("ERROR DRBG output repeated after fork\n");
+    return 1;
+  }
+  return 0;
+}
+
+#ifdef KYBER_PROFILE
+static int test_profile(void)
+{
+  uint8_t *pk[NKEYS];
+  uint8_t *sk[NKEYS];
+
+  uint8_t seed[KYBER_SYMBYTES];
+
+  uint8_t c1[MKYBER_C1BYTES];
+  uint8_t *c2[NKEYS];
+
+  uint8_t key_a[KYBER_SSBYTES];
+  uint8_t key_b[KYBER_SSBYTES];
+
+  mkem_profile profile;
+  unsigned int j;
+  size_t i;
+  int ret = 0;
+
+  for(i=0;i<NKEYS;i++)
+  {
+    pk[i] = malloc(MKYBER_PUBLICKEYBYTES);
+    sk[i] = malloc(MKYBER_SECRETKEYBYTES);
+    c2[i] = malloc(MKYBER_C2BYTES);
+  }
+
+  randombytes(seed, KYBER_SYMBYTES);
+  for(i=0;i<NKEYS;i++)
+    crypto_mkem_keypair(pk[i], sk[i], seed);
+
+  /* Encapsulation runs every phase but verification */
+  crypto_mkem_profile_reset();
+  crypto_mkem_enc(c1, c2, key_a, seed, NKEYS, pk);
+  crypto_mkem_profile_read(&profile);
+  for(j=0;j<MKEM_PROFILE_NPHASES;j++) {
+    if((j == MKEM_PROFILE_VERIFY) != (profile.cycles[j] == 0 && profile.calls[j] == 0)) {
+      printf("ERROR profile phase %s after encapsulation\n", crypto_mkem_profile_name(j));
+      ret = 1;
+    }
+  }
+
+  crypto_mkem_dec(key_b, c1, c2[0], sk[0]);
+  crypto_mkem_profile_read(&profile);
+  if(profile.calls[MKEM_PROFILE_VERIFY] == 0 || memcmp(key_a, key_b, KYBER_SSBYTES)) {
+    printf("ERROR profile decapsulation\n");
+    ret = 1;
+  }
+
+  crypto_mkem_profile_reset();
+  crypto_mkem_profile_read(&profile);
+  for(j=0;j<MKEM_PROFILE_NPHASES;j++) {
+    if(profile.cycles[j] || profile.calls[j]) {
+      printf("ERROR profile reset\n");
+      ret = 1;
+    }
+  }
+  if(crypto_mkem_profile_name(MKEM_PROFILE_NPHASES) != NULL) {
+    printf("ERROR profile phase name\n");
+    ret = 1;
+  }
+
+  for(i=0;i<NKEYS;i++)
+  {
+    free(pk[i]);
+    free(sk[i]);
+    free(c2[i]);
+  }
+
+  return ret;
+}
+#endif
+
 int main(void)
 {
   unsigned int i;
-  int r;
+  int r = 0;
+  mkem_pool *pool;
+  const int badcpus[2][NTHREADS] = {{0, -1}, {0, INT_MAX}};
 
-  for(i=0;i<NTESTS;i++) {
+  pool = crypto_mkem_pool_new(NTHREADS, NULL);
+  if(pool == NULL) {
+    printf("ERROR creating thread pool\n");
+    return 1;
+  }
+  for(i=0;i<2;i++)
+    if(crypto_mkem_pool_new(NTHREADS, badcpus[i]) != NULL) {
+      printf("ERROR thread pool with invalid CPU number created\n");
+      return 1;
+    }
+
+  for(i=0;i<NTESTS && !r;i++) {
     r  = test_keys();
+    r |= test_batch_sizes();
+    r |= test_wide_batches();
+    r |= test_seedctx();
+    r |= test_fwd();
+    r |= test_pool(pool);
+    r |= test_stream(pool);
+    r |= test_session();
+    r |= test_strided();
+    r |= test_keydir();
+    r |= test_dec_batch();
+    r |= test_keypair_batch();
     r |= test_invalid_sk();
     r |= test_invalid_ciphertext();
-    if(r)
-      return 1;
+#ifdef KYBER_PROFILE
+    r |= test_profile();
+#endif
   }
 
-  return 0;
+  /* Functional tests again with the buffered DRBG */
+  if(!r)
+    r = test_drbg();
+  for(i=0;i<NTESTS/10 && !r;i++) {
+    r  = test_keys();
+    r |= test_batch_sizes();
+    r |= test_pool(pool);
+    r |= test_invalid_ciphertext();
+  }
+
+  crypto_mkem_pool_free(pool);
+
+  return r;
 }
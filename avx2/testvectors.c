@@ -7,6 +7,8 @@
 
 #define NTESTS 1000
 #define NKEYS 20
+/* One group of four keys and a remainder of three */
+#define NBATCHKEYS 7
 
 static uint32_t rbseed[32] = {
   3,1,4,1,5,9,2,6,5,3,5,8,9,7,9,3,2,3,8,4,6,2,6,4,3,3,8,3,2,7,9,5
@@ -141,12 +143,59 @@ static int test_keys(void)
   return ret;
 }
 
+/* Checks that crypto_mkem_keypair_batch outputs the same keys as
+ * repeated calls of crypto_mkem_keypair for the same output of
+ * randombytes; prints nothing unless they differ, and leaves the state
+ * of randombytes as it was so that the test vectors are not affected */
+static int test_keypair_batch(void)
+{
+  uint32_t in0[12], out0[8];
+  int outleft0;
+
+  uint8_t seed[KYBER_SYMBYTES];
+  uint8_t pks[NBATCHKEYS][MKYBER_PUBLICKEYBYTES];
+  uint8_t sks[NBATCHKEYS][MKYBER_SECRETKEYBYTES];
+  uint8_t pk[MKYBER_PUBLICKEYBYTES];
+  uint8_t sk[MKYBER_SECRETKEYBYTES];
+
+  size_t i;
+  int ret = 0;
+
+  memcpy(in0, in, sizeof(in));
+  memcpy(out0, out, sizeof(out));
+  outleft0 = outleft;
+
+  randombytes(seed, KYBER_SYMBYTES);
+  crypto_mkem_keypair_batch(pks[0], sks[0], NBATCHKEYS, seed);
+
+  memcpy(in, in0, sizeof(in));
+  memcpy(out, out0, sizeof(out));
+  outleft = outleft0;
+
+  randombytes(seed, KYBER_SYMBYTES);
+  for(i=0;i<NBATCHKEYS;i++)
+  {
+    crypto_mkem_keypair(pk, sk, seed);
+    if(memcmp(pk, pks[i], MKYBER_PUBLICKEYBYTES) || memcmp(sk, sks[i], MKYBER_SECRETKEYBYTES)) {
+      printf("ERROR batch key generation differs at position %lu\n", i);
+      ret = 1;
+      break;
+    }
+  }
+
+  memcpy(in, in0, sizeof(in));
+  memcpy(out, out0, sizeof(out));
+  outleft = outleft0;
+
+  return ret;
+}
 
 int main(void)
 {
   unsigned int i;
 
   for(i=0;i<NTESTS;i++) {
+    if(test_keypair_batch()) return -1;
     if(test_keys()) return -1;
   }
 
@@ -504,6 +504,76 @@ void gen_matrix(polyvec *a, const uint8_t seed[32], int transposed)
   poly_nttunpack(&a[1].vec[0]);
   poly_nttunpack(&a[1].vec[1]);
 }
+#elif defined(KYBER_KECCAK8X)
+/* KYBER_K = 3 or 4: entries are expanded eight at a time by the AVX-512
+ * Keccak, i.e., in two passes for KYBER_K = 4; a single remaining entry
+ * (KYBER_K = 3) uses the 1-way XOF */
+void gen_matrix(polyvec *a, const uint8_t seed[32], int transposed)
+{
+  unsigned int i, j, k, n, ctr[8];
+  ALIGNED_UINT8(REJ_UNIFORM_AVX_NBLOCKS*SHAKE128_RATE) buf[8];
+  const uint8_t *in[8];
+  uint8_t *out[8];
+  poly *r[8];
+  __m256i f;
+  keccakx8_state state;
+  keccak_state state1x;
+
+  f = _mm256_loadu_si256((__m256i *)seed);
+  for(k=0;k<KYBER_K*KYBER_K;k+=n) {
+    n = (KYBER_K*KYBER_K-k < 8) ? KYBER_K*KYBER_K-k : 8;
+
+    for(j=0;j<8;j++) {
+      /* Lanes beyond n repeat the first entry and are not sampled */
+      i = (j < n) ? k+j : k;
+      r[j] = &a[i/KYBER_K].vec[i%KYBER_K];
+      _mm256_store_si256(buf[j].vec, f);
+      if(transposed) {
+        buf[j].coeffs[32] = i/KYBER_K;
+        buf[j].coeffs[33] = i%KYBER_K;
+      }
+      else {
+        buf[j].coeffs[32] = i%KYBER_K;
+        buf[j].coeffs[33] = i/KYBER_K;
+      }
+      in[j] = buf[j].coeffs;
+      out[j] = buf[j].coeffs;
+      ctr[j] = KYBER_N;
+    }
+
+    if(n == 1) {
+      shake128_absorb_once(&state1x, buf[0].coeffs, 34);
+      shake128_squeezeblocks(buf[0].coeffs, REJ_UNIFORM_AVX_NBLOCKS, &state1x);
+      ctr[0] = rej_uniform_avx(r[0]->coeffs, buf[0].coeffs);
+      while(ctr[0] < KYBER_N) {
+        shake128_squeezeblocks(buf[0].coeffs, 1, &state1x);
+        ctr[0] += rej_uniform(r[0]->coeffs + ctr[0], KYBER_N - ctr[0], buf[0].coeffs, SHAKE128_RATE);
+      }
+    }
+    else {
+      shake128x8_absorb_once(&state, in, 34);
+      shake128x8_squeezeblocks(out, REJ_UNIFORM_AVX_NBLOCKS, &state);
+
+      for(j=0;j<n;j++)
+        ctr[j] = rej_uniform_avx(r[j]->coeffs, buf[j].coeffs);
+
+      for(;;) {
+        for(j=0;j<n;j++)
+          if(ctr[j] < KYBER_N)
+            break;
+        if(j == n)
+          break;
+
+        shake128x8_squeezeblocks(out, 1, &state);
+        for(j=0;j<n;j++)
+          ctr[j] += rej_uniform(r[j]->coeffs + ctr[j], KYBER_N - ctr[j], buf[j].coeffs, SHAKE128_RATE);
+      }
+    }
+
+    for(j=0;j<n;j++)
+      poly_nttunpack(r[j]);
+  }
+}
 #elif KYBER_K == 3
 void gen_matrix(polyvec *a, const uint8_t seed[32], int transposed)
 {
@@ -687,40 +757,98 @@ void gen_matrix(polyvec *a, const uint8_t seed[32], int transposed)
 #endif
 
 
-#define GEN_POLY_NBLOCKS ((12*KYBER_N/8*(1 << 12)/KYBER_Q + XOF_BLOCKBYTES)/XOF_BLOCKBYTES)
-
 /*************************************************
 * Name:        gen_polyvec
 *
 * Description: Deterministically generate polyvec a from a seed.  Entries 
 *              of the polyvec are polynomials that look uniformly random. 
-*              Performs rejection sampling on output of a XOF
+*              Performs rejection sampling on output of a XOF; the KYBER_K
+*              entries are squeezed in parallel from the 4-way XOF.
 *
 * Arguments:   - polyvec *a: pointer to ouptput polyvec
 *              - const uint8_t *seed: pointer to input seed
 **************************************************/
-/* TODO: Optimize this using AVX2 */
 void gen_polyvec(polyvec *a, const uint8_t seed[KYBER_SYMBYTES])
 {
-  unsigned int ctr, i, k;
-  unsigned int buflen, off;
-  uint8_t buf[GEN_POLY_NBLOCKS*XOF_BLOCKBYTES+2];
-  xof_state state;
+  unsigned int i, ctr[4];
+  ALIGNED_UINT8(REJ_UNIFORM_AVX_NBLOCKS*SHAKE128_RATE) buf[4];
+  keccakx4_state state;
+
+  /* Lanes beyond KYBER_K are squeezed but not sampled */
+  for(i=0;i<4;i++) {
+    _mm256_store_si256(buf[i].vec, _mm256_loadu_si256((__m256i *)seed));
+    buf[i].coeffs[32] = 0;
+    buf[i].coeffs[33] = i;
+    ctr[i] = KYBER_N;
+  }
+
+  shake128x4_absorb_once(&state, buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, 34);
+  shake128x4_squeezeblocks(buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, REJ_UNIFORM_AVX_NBLOCKS, &state);
+
+  for(i=0;i<KYBER_K;i++)
+    ctr[i] = rej_uniform_avx(a->vec[i].coeffs, buf[i].coeffs);
+
+  while(ctr[0] < KYBER_N || ctr[1] < KYBER_N || ctr[2] < KYBER_N || ctr[3] < KYBER_N) {
+    shake128x4_squeezeblocks(buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, 1, &state);
+
+    for(i=0;i<KYBER_K;i++)
+      ctr[i] += rej_uniform(a->vec[i].coeffs + ctr[i], KYBER_N - ctr[i], buf[i].coeffs, SHAKE128_RATE);
+  }
+}
+
+/*************************************************
+* Name:        gen_polyvec_4x
+*
+* Description: Deterministically generate four polyvecs from four
+*              independent seeds; output is identical to four calls
+*              to gen_polyvec, but the XOF runs four lanes at a time.
+*
+* Arguments:   - polyvec *a0-a3: pointers to output polyvecs
+*              - const uint8_t *seed0-seed3: pointers to input seeds
+**************************************************/
+void gen_polyvec_4x(polyvec *a0,
+                    polyvec *a1,
+                    polyvec *a2,
+                    polyvec *a3,
+                    const uint8_t seed0[KYBER_SYMBYTES],
+                    const uint8_t seed1[KYBER_SYMBYTES],
+                    const uint8_t seed2[KYBER_SYMBYTES],
+                    const uint8_t seed3[KYBER_SYMBYTES])
+{
+  unsigned int i, ctr0, ctr1, ctr2, ctr3;
+  ALIGNED_UINT8(REJ_UNIFORM_AVX_NBLOCKS*SHAKE128_RATE) buf[4];
+  keccakx4_state state;
 
   for(i=0;i<KYBER_K;i++) {
-    xof_absorb(&state, seed, 0, i);
-
-    xof_squeezeblocks(buf, GEN_POLY_NBLOCKS, &state);
-    buflen = GEN_POLY_NBLOCKS*XOF_BLOCKBYTES;
-    ctr = rej_uniform(a->vec[i].coeffs, KYBER_N, buf, buflen);
-
-    while(ctr < KYBER_N) {
-      off = buflen % 3;
-      for(k = 0; k < off; k++)
-        buf[k] = buf[buflen - off + k];
-      xof_squeezeblocks(buf + off, 1, &state);
-      buflen = off + XOF_BLOCKBYTES;
-      ctr += rej_uniform(a->vec[i].coeffs + ctr, KYBER_N - ctr, buf, buflen);
+    _mm256_store_si256(buf[0].vec, _mm256_loadu_si256((__m256i *)seed0));
+    _mm256_store_si256(buf[1].vec, _mm256_loadu_si256((__m256i *)seed1));
+    _mm256_store_si256(buf[2].vec, _mm256_loadu_si256((__m256i *)seed2));
+    _mm256_store_si256(buf[3].vec, _mm256_loadu_si256((__m256i *)seed3));
+
+    buf[0].coeffs[32] = 0;
+    buf[0].coeffs[33] = i;
+    buf[1].coeffs[32] = 0;
+    buf[1].coeffs[33] = i;
+    buf[2].coeffs[32] = 0;
+    buf[2].coeffs[33] = i;
+    buf[3].coeffs[32] = 0;
+    buf[3].coeffs[33] = i;
+
+    shake128x4_absorb_once(&state, buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, 34);
+    shake128x4_squeezeblocks(buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, REJ_UNIFORM_AVX_NBLOCKS, &state);
+
+    ctr0 = rej_uniform_avx(a0->vec[i].coeffs, buf[0].coeffs);
+    ctr1 = rej_uniform_avx(a1->vec[i].coeffs, buf[1].coeffs);
+    ctr2 = rej_uniform_avx(a2->vec[i].coeffs, buf[2].coeffs);
+    ctr3 = rej_uniform_avx(a3->vec[i].coeffs, buf[3].coeffs);
+
+    while(ctr0 < KYBER_N || ctr1 < KYBER_N || ctr2 < KYBER_N || ctr3 < KYBER_N) {
+      shake128x4_squeezeblocks(buf[0].coeffs, buf[1].coeffs, buf[2].coeffs, buf[3].coeffs, 1, &state);
+
+      ctr0 += rej_uniform(a0->vec[i].coeffs + ctr0, KYBER_N - ctr0, buf[0].coeffs, SHAKE128_RATE);
+      ctr1 += rej_uniform(a1->vec[i].coeffs + ctr1, KYBER_N - ctr1, buf[1].coeffs, SHAKE128_RATE);
+      ctr2 += rej_uniform(a2->vec[i].coeffs + ctr2, KYBER_N - ctr2, buf[2].coeffs, SHAKE128_RATE);
+      ctr3 += rej_uniform(a3->vec[i].coeffs + ctr3, KYBER_N - ctr3, buf[3].coeffs, SHAKE128_RATE);
     }
   }
 }
@@ -15,4 +15,14 @@ void gen_matrix(polyvec *a, const uint8_t seed[KYBER_SYMBYTES], int transposed);
 #define gen_polyvec KYBER_NAMESPACE(gen_polyvec)
 void gen_polyvec(polyvec *a, const uint8_t seed[KYBER_SYMBYTES]);
 
+#define gen_polyvec_4x KYBER_NAMESPACE(gen_polyvec_4x)
+void gen_polyvec_4x(polyvec *a0,
+                    polyvec *a1,
+                    polyvec *a2,
+                    polyvec *a3,
+                    const uint8_t seed0[KYBER_SYMBYTES],
+                    const uint8_t seed1[KYBER_SYMBYTES],
+                    const uint8_t seed2[KYBER_SYMBYTES],
+                    const uint8_t seed3[KYBER_SYMBYTES]);
+
 #endif
@@ -0,0 +1,162 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mkem.h"
+#include "mkem_dispatch.h"
+
+/* Entry points of the bundled implementations; the backend objects are
+ * built from ../ref and ../avx2 with all other symbols made local and
+ * crypto_mkem_X renamed to mkyber_<impl>_crypto_mkem_X (see Makefile) */
+#define DECLARE_IMPL(impl) \
+  int mkyber_##impl##_crypto_mkem_keypair(uint8_t *pk, uint8_t *sk, const uint8_t *seed); \
+  int mkyber_##impl##_crypto_mkem_enc_c1(uint8_t *c1, uint8_t *ss, uint8_t *fwd, \
+                                         const uint8_t *seed, const uint8_t *r); \
+  int mkyber_##impl##_crypto_mkem_enc_c2(uint8_t *c2, const uint8_t *pk, \
+                                         const uint8_t *r, const uint8_t *fwd); \
+  int mkyber_##impl##_crypto_mkem_enc(uint8_t *c1, uint8_t **c2s, uint8_t *ss, \
+                                      const uint8_t *seed, size_t num_keys, \
+                                      uint8_t *const* pk); \
+  int mkyber_##impl##_crypto_mkem_dec(uint8_t *ss, const uint8_t *c1, \
+                                      const uint8_t *c2, const uint8_t *sk);
+
+#define IMPL_ENTRY(impl) \
+  { #impl, \
+    mkyber_##impl##_crypto_mkem_keypair, \
+    mkyber_##impl##_crypto_mkem_enc_c1, \
+    mkyber_##impl##_crypto_mkem_enc_c2, \
+    mkyber_##impl##_crypto_mkem_enc, \
+    mkyber_##impl##_crypto_mkem_dec }
+
+DECLARE_IMPL(ref)
+DECLARE_IMPL(avx2)
+DECLARE_IMPL(avx512)
+
+typedef struct {
+  const char *name;
+  int (*keypair)(uint8_t *pk, uint8_t *sk, const uint8_t *seed);
+  int (*enc_c1)(uint8_t *c1, uint8_t *ss, uint8_t *fwd,
+                const uint8_t *seed, const uint8_t *r);
+  int (*enc_c2)(uint8_t *c2, const uint8_t *pk,
+                const uint8_t *r, const uint8_t *fwd);
+  int (*enc)(uint8_t *c1, uint8_t **c2s, uint8_t *ss,
+             const uint8_t *seed, size_t num_keys, uint8_t *const* pk);
+  int (*dec)(uint8_t *ss, const uint8_t *c1,
+             const uint8_t *c2, const uint8_t *sk);
+} mkem_impl;
+
+/* Ordered from slowest to fastest */
+static const mkem_impl impls[] = {
+  IMPL_ENTRY(ref),
+  IMPL_ENTRY(avx2),
+  IMPL_ENTRY(avx512)
+};
+
+#define NIMPLS (sizeof(impls)/sizeof(impls[0]))
+
+/* Portable until mkem_dispatch_init has run */
+static const mkem_impl *impl = &impls[0];
+
+/*************************************************
+* Name:        impl_supported
+*
+* Description: Checks whether the CPU (and operating system) supports
+*              the instruction set extensions used by impls[i]
+*
+* Arguments:   - size_t i: index into impls
+*
+* Returns 1 if supported, 0 otherwise
+**************************************************/
+static int impl_supported(size_t i)
+{
+  int avx2;
+
+  if(i == 0)
+    return 1;
+
+  avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")
+      && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("aes");
+  if(i == 1)
+    return avx2;
+  return avx2 && __builtin_cpu_supports("avx512f");
+}
+
+/*************************************************
+* Name:        mkem_dispatch_init
+*
+* Description: Selects the fastest implementation supported by the CPU
+*              once at load time. The environment variable MKYBER_IMPL
+*              (ref, avx2 or avx512) selects a slower implementation
+*              instead; unknown or unsupported names are ignored.
+**************************************************/
+__attribute__((constructor))
+static void mkem_dispatch_init(void)
+{
+  size_t i, best = 0;
+  const char *name;
+
+  __builtin_cpu_init();
+  for(i=0;i<NIMPLS;i++)
+    if(impl_supported(i))
+      best = i;
+
+  name = getenv("MKYBER_IMPL");
+  if(name != NULL)
+    for(i=0;i<best;i++)
+      if(strcmp(name, impls[i].name) == 0)
+        best = i;
+
+  impl = &impls[best];
+}
+
+/*************************************************
+* Name:        crypto_mkem_impl
+*
+* Description: Returns the name of the implementation selected at load time
+**************************************************/
+const char *crypto_mkem_impl(void)
+{
+  return impl->name;
+}
+
+int crypto_mkem_keypair(uint8_t *pk,
+                        uint8_t *sk,
+                        const uint8_t *seed)
+{
+  return impl->keypair(pk, sk, seed);
+}
+
+int crypto_mkem_enc_c1(uint8_t *c1,
+                       uint8_t *ss,
+                       uint8_t *fwd,
+                       const uint8_t *seed,
+                       const uint8_t *r)
+{
+  return impl->enc_c1(c1, ss, fwd, seed, r);
+}
+
+int crypto_mkem_enc_c2(uint8_t *c2,
+                       const uint8_t *pk,
+                       const uint8_t *r,
+                       const uint8_t *fwd)
+{
+  return impl->enc_c2(c2, pk, r, fwd);
+}
+
+int crypto_mkem_enc(uint8_t *c1,
+                    uint8_t **c2s,
+                    uint8_t *ss,
+                    const uint8_t *seed,
+                    size_t num_keys,
+                    uint8_t *const* pk)
+{
+  return impl->enc(c1, c2s, ss, seed, num_keys, pk);
+}
+
+int crypto_mkem_dec(uint8_t *ss,
+                    const uint8_t *c1,
+                    const uint8_t *c2,
+                    const uint8_t *sk)
+{
+  return impl->dec(ss, c1, c2, sk);
+}
@@ -0,0 +1,8 @@
+#ifndef KYBER_MKEM_DISPATCH_H
+#define KYBER_MKEM_DISPATCH_H
+
+#include "mkem.h"
+
+const char *crypto_mkem_impl(void);
+
+#endif
@@ -0,0 +1,11 @@
+#!/bin/bash
+
+for impl in ref avx2 avx512; do
+  export MKYBER_IMPL=$impl
+  ./test_mkyber512
+  ./test_mkyber768
+  ./test_mkyber1024
+  ./testvectors512 | diff - ../ref/vectors512
+  ./testvectors768 | diff - ../ref/vectors768
+  ./testvectors1024 | diff - ../ref/vectors1024
+done